@@ -1,26 +1,106 @@
 #include "ai.h"
 #include <algorithm>
 #include <cstring>
+#include <cmath>
+#include <thread>
 
 namespace PigsAndFarmers {
 
-AI::AI() : transTable(TT_SIZE), ttAge(0) {
-    shouldStop = false;
-    searching = false;
-    clearKillers();
-    clearHash();
+namespace {
+
+// Late move reductions by [depth][move number], log-log like most engines
+std::array<std::array<int, MAX_MOVES + 1>, MAX_PLY> lmrTable;
+
+void initLmrTable() {
+    static bool initialized = false;
+    if (initialized) return;
+    for (int d = 1; d < MAX_PLY; d++) {
+        for (int m = 1; m <= MAX_MOVES; m++) {
+            lmrTable[d][m] = static_cast<int>(0.5 + std::log(d) * std::log(m) / 2.0);
+        }
+    }
+    initialized = true;
 }
 
-AI::~AI() {
-    shouldStop = true;
+int lmrReduction(int depth, int moveNumber) {
+    return lmrTable[std::min(depth, MAX_PLY - 1)][std::min(moveNumber, MAX_MOVES)];
 }
 
-void AI::clearHash() {
-    std::fill(transTable.begin(), transTable.end(), TTEntry{});
-    ttAge = 0;
+// SearchStats counting, compiled out unless SEARCH_STATS is defined (the
+// expression is still type-checked, unevaluated, so it can't rot).
+// STAT_TIMER adds the time to the end of the enclosing scope to a counter.
+#ifdef SEARCH_STATS
+class StatTimer {
+public:
+    explicit StatTimer(uint64_t& total) : total(total), start(std::chrono::steady_clock::now()) {}
+    ~StatTimer() {
+        total += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    uint64_t& total;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define SEARCH_STAT(expr) (expr)
+#define STAT_TIMER(counter) StatTimer statTimer(counter)
+#else
+#define SEARCH_STAT(expr) ((void)sizeof(expr))
+#define STAT_TIMER(counter) ((void)0)
+#endif
+
+// Stable sort by descending score. There are at most MAX_MOVES root moves,
+// and unlike std::stable_sort this needs no temporary buffer.
+void sortRootMoves(std::vector<RootMove>::iterator first, std::vector<RootMove>::iterator last) {
+    for (auto it = first; it != last; ++it) {
+        RootMove rm = *it;
+        auto hole = it;
+        for (; hole != first && (hole - 1)->score < rm.score; --hole) {
+            *hole = *(hole - 1);
+        }
+        *hole = rm;
+    }
 }
 
-void AI::clearKillers() {
+// Scopes SearchThread::cycleFloor to one node: a repeat found below it
+// that goes back above it is passed on to the parent, others are dropped
+class CycleScope {
+public:
+    CycleScope(SearchThread& t, int ply) : t(t), ply(ply), saved(t.cycleFloor) {
+        t.cycleFloor = NO_CYCLE;
+    }
+    ~CycleScope() {
+        t.cycleFloor = std::min(saved, pathDependent() ? t.cycleFloor : NO_CYCLE);
+    }
+
+    bool pathDependent() const { return t.cycleFloor < ply; }
+
+private:
+    SearchThread& t;
+    int ply;
+    int saved;
+};
+
+} // namespace
+
+void SearchStats::add(const SearchStats& other) {
+    mainNodes += other.mainNodes;
+    qsNodes += other.qsNodes;
+    betaCutoffs += other.betaCutoffs;
+    for (int i = 0; i < CUTOFF_SLOTS; i++) cutoffsAt[i] += other.cutoffsAt[i];
+    ttProbes += other.ttProbes;
+    ttHits += other.ttHits;
+    ttCollisions += other.ttCollisions;
+    ttStores += other.ttStores;
+    ttOverwrites += other.ttOverwrites;
+    for (int d = 0; d < MAX_PLY; d++) iterationNodes[d] += other.iterationNodes[d];
+    movegenNs += other.movegenNs;
+    evalNs += other.evalNs;
+    orderingNs += other.orderingNs;
+}
+
+void SearchThread::clearHeuristics() {
     for (auto& k : killers) {
         k[0] = Move();
         k[1] = Move();
@@ -30,168 +110,211 @@ void AI::clearKillers() {
     }
 }
 
-int AI::evaluate(const Game& game) const {
-    // Get basic state
-    int pawnCount = game.getPawnCount();
-    int queenSq = game.getQueenSquare();
+AI::AI() : tt(DEFAULT_HASH_MB) {
+    initLmrTable();
+    shouldStop = false;
+    searching = false;
+    pondering = false;
+    setThreads(1);
+}
 
-    // Terminal states
-    GameResult result = game.getResult();
-    if (result == GameResult::WHITE_WINS_PROMOTION ||
-        result == GameResult::WHITE_WINS_CAPTURE) {
-        return MATE_SCORE - 100;  // White wins
+AI::~AI() {
+    shouldStop = true;
+    waitSearch();
+}
+
+void AI::setThreads(int n) {
+    n = std::max(1, std::min(n, MAX_THREADS));
+
+    threads.resize(n);
+    for (int i = 0; i < n; i++) {
+        if (!threads[i]) {
+            threads[i] = std::make_unique<SearchThread>();
+            threads[i]->id = i;
+            threads[i]->clearHeuristics();
+        }
     }
-    if (result == GameResult::BLACK_WINS) {
-        return -MATE_SCORE + 100;  // Black wins
+}
+
+void AI::clearHash() {
+    tt.clear();
+}
+
+void AI::clearKillers() {
+    for (auto& t : threads) {
+        t->clearHeuristics();
     }
-    if (result == GameResult::DRAW_STALEMATE) {
-        return 0;
+}
+
+uint64_t AI::getNodes() const {
+    uint64_t total = 0;
+    for (const auto& t : threads) {
+        total += t->nodes.load(std::memory_order_relaxed);
     }
+    return total;
+}
 
-    int score = 0;
+uint64_t AI::getTTHits() const {
+    uint64_t total = 0;
+    for (const auto& t : threads) {
+        total += t->ttHits;
+    }
+    return total;
+}
 
-    // Material
-    score += pawnCount * PAWN_VALUE;
-    if (queenSq != NO_SQUARE) {
-        score -= QUEEN_VALUE;
+SearchStats AI::getSearchStats() const {
+    SearchStats total;
+    for (const auto& t : threads) {
+        total.add(t->stats);
     }
+    return total;
+}
 
-    // Pawn advancement bonus (crucial for this game)
-    // First, calculate queen attacks to know which pawns are under threat
-    Bitboard queenAttacksBB = 0;
-    if (queenSq != NO_SQUARE) {
-        Bitboard occupied = game.getPawns() | game.getQueen();
-        queenAttacksBB = Game::queenAttacks(queenSq, occupied);
+int AI::pawnScore(SearchThread& t) const {
+    const Game& game = t.game;
+    PawnEntry& entry = t.pawnHash[game.getPawnKey()];
+    if (entry.key == game.getPawnKey()) {
+        return entry.score;
     }
 
+    // Material, advancement and connected pairs
     Bitboard pawns = game.getPawns();
-    while (pawns) {
-        int sq = Game::lsb(pawns);
-        pawns &= pawns - 1;
-
-        int rank = rankOf(sq);
-        bool canBeCaptured = (queenAttacksBB & squareBB(sq)) != 0;
-        bool isQueenTurn = (game.getSideToMove() == BLACK);
-
-        // Exponential bonus for advancement
-        // Rank 2=0, 3=5, 4=15, 5=35, 6=75, 7=155
-        int advBonus = (1 << (rank - 1)) * 5;
-
-        // Extra bonus for pawns close to promotion
-        int promoBonus = 0;
-        if (rank >= 5) {
-            promoBonus += (rank - 4) * 50;
-        }
-        if (rank == 7) {
-            promoBonus += 200;  // One move from promotion!
-        }
+    int score = Game::popCount(pawns) * Eval::PARAMS.pawnValue;
+    for (Bitboard bb = pawns; bb; bb &= bb - 1) {
+        score += Eval::PAWN_PSQ[Game::lsb(bb)];
+    }
+    score += Game::popCount(pawns & (pawns << 1) & ~FILE_A) * Eval::PARAMS.connectedPair;
 
-        // If pawn can be captured and it's queen's turn, significantly reduce bonus
-        // because the queen will likely capture it
-        if (canBeCaptured && isQueenTurn) {
-            // Pawn is in danger - reduce advancement bonus significantly
-            advBonus /= 4;
-            promoBonus /= 4;
-        } else if (canBeCaptured) {
-            // White to move - pawn might escape or promote
-            // Still give some penalty for being attacked
-            advBonus = advBonus * 3 / 4;
-            promoBonus = promoBonus * 3 / 4;
-        }
+    entry.key = game.getPawnKey();
+    entry.score = score;
+    return score;
+}
 
-        score += advBonus + promoBonus;
+template<Side S>
+int AI::evaluate(SearchThread& t) const {
+    STAT_TIMER(t.stats.evalNs);
+    const Game& game = t.game;
+    Bitboard pawns = game.getPawns();
+    Bitboard queen = game.getQueen();
+
+    // Terminal states. Callers have already returned on stalemate (via
+    // getResult) before asking for a static score.
+    if ((pawns & RANK_8) || queen == 0) {
+        return MATE_SCORE - 100;  // White wins
+    }
+    if (pawns == 0) {
+        return -MATE_SCORE + 100;  // Black wins
     }
 
-    // Queen positioning (for Black)
-    if (queenSq != NO_SQUARE) {
-        int qRank = rankOf(queenSq);
-        int qFile = fileOf(queenSq);
+    // Cached pawn structure plus the incrementally maintained queen placement
+    int score = pawnScore(t) - Eval::PARAMS.queenValue + game.getEvalState().queenPsq;
+
+    // Queen-dependent terms need her attack set, computed once here
+    int queenSq = Game::lsb(queen);
+    Bitboard attacks = Game::queenAttacks(queenSq, pawns | queen);
+    Bitboard threatened = attacks & pawns;
 
-        // Queen wants to be active and central
-        // Slightly prefer being in front of pawns
-        int centralityBonus = 4 - std::abs(qFile - 3);  // Center files better
-        score -= centralityBonus * 5;
+    // Attacked pawns keep only part of their advancement bonus
+    const auto& threatLoss = Eval::PAWN_THREAT_LOSS[S == BLACK];
+    for (Bitboard bb = threatened; bb; bb &= bb - 1) {
+        score -= threatLoss[Game::lsb(bb)];
+    }
 
-        // Queen prefers lower ranks to block pawns
-        score -= (8 - qRank) * 3;
+    score -= Game::popCount(attacks) * Eval::PARAMS.queenMobility;
+    score -= Game::popCount(threatened) * Eval::PARAMS.queenThreat;
 
-        // Mobility bonus for queen
-        Bitboard occupied = game.getPawns() | game.getQueen();
-        Bitboard queenMoves = Game::queenAttacks(queenSq, occupied);
-        int mobility = Game::popCount(queenMoves & ~game.getQueen());
-        score -= mobility * 2;
+    // Pawns with the queen ahead on their file are blocked
+    Bitboard behindQueen = (FILE_A << fileOf(queenSq)) & (squareBB(queenSq) - 1);
+    score -= Game::popCount(pawns & behindQueen) * Eval::PARAMS.blockedFile;
 
-        // Count pawns queen can attack
-        int attackablePawns = Game::popCount(queenMoves & game.getPawns());
-        score -= attackablePawns * 10;
-    }
+    // Side to move bonus
+    score += S == WHITE ? Eval::PARAMS.tempo : -Eval::PARAMS.tempo;
 
-    // Pawn structure
-    // Connected pawns are stronger
-    Bitboard pawnsBB = game.getPawns();
-    Bitboard pawnsCopy = pawnsBB;
-    while (pawnsCopy) {
-        int sq = Game::lsb(pawnsCopy);
-        pawnsCopy &= pawnsCopy - 1;
+    return score;
+}
 
-        int file = fileOf(sq);
-        int rank = rankOf(sq);
+int AI::evaluate(SearchThread& t) const {
+    return t.game.getSideToMove() == WHITE ? evaluate<WHITE>(t) : evaluate<BLACK>(t);
+}
 
-        // Check for adjacent pawns (protection)
-        if (file > 0 && (pawnsBB & squareBB(sq - 1))) score += 5;
-        if (file < 7 && (pawnsBB & squareBB(sq + 1))) score += 5;
+// Mirrors evaluate<S>() term by term; the two must change together
+bool Eval::features(Bitboard pawns, Bitboard queen, Side side, EvalParams& counts) {
+    counts = EvalParams{};
+    if ((pawns & RANK_8) || queen == 0 || pawns == 0) return false;
 
-        // Passed pawn detection (no queen in front)
-        if (queenSq != NO_SQUARE) {
-            int qFile = fileOf(queenSq);
-            int qRank = rankOf(queenSq);
+    // Stalemate, the side to move having no legal move
+    Game game;
+    game.setPosition(pawns, queen, side);
+    if (game.getResult() != GameResult::ONGOING) return false;
 
-            // If queen is on same file ahead, pawn is blocked
-            if (qFile == file && qRank > rank) {
-                score -= 20;
-            }
-        }
+    counts.pawnValue = Game::popCount(pawns);
+    counts.queenValue = -1;
+    for (Bitboard bb = pawns; bb; bb &= bb - 1) {
+        counts.pawnRank[rankOf(Game::lsb(bb))]++;
     }
+    counts.connectedPair = Game::popCount(pawns & (pawns << 1) & ~FILE_A);
 
-    // Side to move bonus
-    if (game.getSideToMove() == WHITE) {
-        score += 10;  // Tempo
-    } else {
-        score -= 10;
+    int queenSq = Game::lsb(queen);
+    counts.queenFile[fileOf(queenSq)] = 1;
+    counts.queenRank[rankOf(queenSq)] = 1;
+
+    Bitboard attacks = Game::queenAttacks(queenSq, pawns | queen);
+    Bitboard threatened = attacks & pawns;
+    for (Bitboard bb = threatened; bb; bb &= bb - 1) {
+        counts.threatLoss[side == BLACK][rankOf(Game::lsb(bb))]--;
     }
+    counts.queenMobility = -Game::popCount(attacks);
+    counts.queenThreat = -Game::popCount(threatened);
 
-    return score;
+    Bitboard behindQueen = (FILE_A << fileOf(queenSq)) & (squareBB(queenSq) - 1);
+    counts.blockedFile = -Game::popCount(pawns & behindQueen);
+
+    counts.tempo = side == WHITE ? 1 : -1;
+    return true;
 }
 
-void AI::storeTT(uint64_t hash, int score, int depth, TTFlag flag, Move bestMove) {
-    size_t index = hash % TT_SIZE;
-    TTEntry& entry = transTable[index];
+int Eval::dot(const EvalParams& weights, const EvalParams& counts) {
+    // Walk both structs' fields in step
+    int values[EVAL_PARAM_COUNT];
+    int n = 0;
+    forEachParam(weights, [&](const char*, int w) { values[n++] = w; });
 
-    // Replace if: same position, deeper, or old entry
-    if (entry.hash != hash || depth >= entry.depth || entry.age != ttAge) {
-        entry.hash = hash;
-        entry.score = static_cast<int16_t>(score);
-        entry.depth = static_cast<int8_t>(depth);
-        entry.flag = flag;
-        entry.bestMove = bestMove;
-        entry.age = ttAge;
-    }
+    int score = 0;
+    n = 0;
+    forEachParam(counts, [&](const char*, int c) { score += values[n++] * c; });
+    return score;
 }
 
-TTEntry* AI::probeTT(uint64_t hash) {
-    size_t index = hash % TT_SIZE;
-    TTEntry& entry = transTable[index];
+std::vector<int> Eval::evaluateBatch(const std::vector<BatchPosition>& positions,
+                                     const EvalParams& weights) {
+    std::vector<int> scores(positions.size());
+    EvalParams counts;
+    for (size_t i = 0; i < positions.size(); i++) {
+        const BatchPosition& p = positions[i];
+        if (features(p.pawns, p.queen, p.side, counts)) {
+            scores[i] = dot(weights, counts);
+        } else if ((p.pawns & RANK_8) || p.queen == 0 || p.pawns == 0) {
+            // Won games score as mates, like evaluate()
+            scores[i] = p.pawns == 0 ? -MATE_SCORE + 100 : MATE_SCORE - 100;
+        } else {
+            scores[i] = 0;  // Stalemate
+        }
+    }
+    return scores;
+}
 
-    // Only use entries from current or recent searches
-    // Old entries might have incorrect scores due to different game states
-    if (entry.hash == hash && (entry.age == ttAge || entry.age == ttAge - 1)) {
-        ttHits++;
-        return &entry;
+bool AI::probeTT(SearchThread& t, uint64_t hash, TTEntry& entry) {
+    SEARCH_STAT(t.stats.ttProbes++);
+    if (tt.probe(hash, entry)) {
+        t.ttHits++;
+        SEARCH_STAT(t.stats.ttHits++);
+        return true;
     }
-    return nullptr;
+    return false;
 }
 
-int AI::scoreMove(Move move, const Game& game, Move ttMove, int ply) const {
+template<Side S>
+int AI::scoreMove(const SearchThread& t, Move move, Move ttMove, int ply) const {
     // TT move gets highest priority
     if (move == ttMove) {
         return 1000000;
@@ -202,7 +325,7 @@ int AI::scoreMove(Move move, const Game& game, Move ttMove, int ply) const {
     // Captures: MVV-LVA (Most Valuable Victim - Least Valuable Aggressor)
     if (move.isCapture()) {
         // In this game: pawn can capture queen (huge), queen captures pawn
-        if (game.getSideToMove() == WHITE) {
+        if constexpr (S == WHITE) {
             // Pawn capturing queen
             score = 900000;  // Queen value
         } else {
@@ -212,36 +335,38 @@ int AI::scoreMove(Move move, const Game& game, Move ttMove, int ply) const {
     }
 
     // Killer moves
-    if (ply < 128) {
-        if (move == killers[ply][0]) score += 90000;
-        else if (move == killers[ply][1]) score += 80000;
+    if (ply < MAX_PLY) {
+        if (move == t.killers[ply][0]) score += 90000;
+        else if (move == t.killers[ply][1]) score += 80000;
     }
 
     // History heuristic
-    score += history[move.from()][move.to()];
+    score += t.history[move.from()][move.to()];
 
-    // Promotion moves (reaching rank 8)
-    if (game.getSideToMove() == WHITE && move.to() >= A8) {
-        score += 500000;
-    }
+    if constexpr (S == WHITE) {
+        // Promotion moves (reaching rank 8)
+        if (move.to() >= A8) {
+            score += 500000;
+        }
 
-    // Pawn advancement
-    if (game.getSideToMove() == WHITE) {
+        // Pawn advancement
         score += rankOf(move.to()) * 100;
     }
 
     return score;
 }
 
-void AI::orderMoves(std::vector<Move>& moves, const Game& game, Move ttMove, int ply) const {
-    std::vector<std::pair<int, Move>> scored;
-    scored.reserve(moves.size());
+void AI::orderMoves(const SearchThread& t, MoveList& moves, Move ttMove, int ply) const {
+    std::array<std::pair<int, Move>, MAX_MOVES> scored;
+    bool white = t.game.getSideToMove() == WHITE;
 
-    for (const Move& m : moves) {
-        scored.push_back({scoreMove(m, game, ttMove, ply), m});
+    for (size_t i = 0; i < moves.size(); i++) {
+        int score = white ? scoreMove<WHITE>(t, moves[i], ttMove, ply)
+                          : scoreMove<BLACK>(t, moves[i], ttMove, ply);
+        scored[i] = {score, moves[i]};
     }
 
-    std::sort(scored.begin(), scored.end(),
+    std::sort(scored.begin(), scored.begin() + moves.size(),
               [](const auto& a, const auto& b) { return a.first > b.first; });
 
     for (size_t i = 0; i < moves.size(); i++) {
@@ -249,12 +374,171 @@ void AI::orderMoves(std::vector<Move>& moves, const Game& game, Move ttMove, int
     }
 }
 
-bool AI::checkTime() {
-    if (timeLimitMs <= 0) return false;
+template<Side S>
+MovePicker<S>::MovePicker(const AI& ai, const SearchThread& t, Move ttMove, int ply)
+    : ai(ai), thread(t), game(t.game), ttMove(ttMove), ply(ply), capturesOnly(false),
+      stage(STAGE_TT_MOVE), current(0), killerIndex(0) {}
+
+template<Side S>
+MovePicker<S>::MovePicker(const AI& ai, const SearchThread& t, int ply)
+    : ai(ai), thread(t), game(t.game), ttMove(), ply(ply), capturesOnly(true),
+      stage(STAGE_GEN_CAPTURES), current(0), killerIndex(0) {}
+
+template<Side S>
+bool MovePicker<S>::isTactical(Move move) const {
+    // Captures and pawn pushes to rank 8 (queen moves to rank 8 are quiet)
+    return move.isCapture() || (S == WHITE && move.isPromotion());
+}
+
+template<Side S>
+bool MovePicker<S>::isKiller(Move move) const {
+    return move == thread.killers[ply][0] || move == thread.killers[ply][1];
+}
+
+template<Side S>
+void MovePicker<S>::scoreMoves() {
+    STAT_TIMER(thread.stats.orderingNs);
+    for (size_t i = 0; i < moves.size(); i++) {
+        scores[i] = ai.scoreMove<S>(thread, moves[i], Move(), ply);
+    }
+}
+
+template<Side S>
+Move MovePicker<S>::selectBest() {
+    STAT_TIMER(thread.stats.orderingNs);
+    size_t best = current;
+    for (size_t i = current + 1; i < moves.size(); i++) {
+        if (scores[i] > scores[best]) best = i;
+    }
+    std::swap(moves[current], moves[best]);
+    std::swap(scores[current], scores[best]);
+    return moves[current++];
+}
+
+template<Side S>
+Move MovePicker<S>::next() {
+    switch (stage) {
+        case STAGE_TT_MOVE:
+            stage = STAGE_GEN_CAPTURES;
+            if (ttMove.isValid() && game.isLegalMove<S>(ttMove)) {
+                return ttMove;
+            }
+            [[fallthrough]];
+
+        case STAGE_GEN_CAPTURES:
+            {
+                STAT_TIMER(thread.stats.movegenNs);
+                game.generateCaptures<S>(moves);
+            }
+            scoreMoves();
+            current = 0;
+            stage = STAGE_CAPTURES;
+            [[fallthrough]];
+
+        case STAGE_CAPTURES:
+            while (current < moves.size()) {
+                Move m = selectBest();
+                if (m != ttMove) return m;
+            }
+            if (capturesOnly) {
+                stage = STAGE_DONE;
+                return Move();
+            }
+            stage = STAGE_KILLERS;
+            [[fallthrough]];
+
+        case STAGE_KILLERS:
+            while (killerIndex < 2) {
+                Move killer = thread.killers[ply][killerIndex++];
+                if (killer.isValid() && killer != ttMove && !isTactical(killer) &&
+                    game.isLegalMove<S>(killer)) {
+                    return killer;
+                }
+            }
+            stage = STAGE_GEN_QUIETS;
+            [[fallthrough]];
+
+        case STAGE_GEN_QUIETS:
+            moves.clear();
+            {
+                STAT_TIMER(thread.stats.movegenNs);
+                game.generateQuiets<S>(moves);
+            }
+            scoreMoves();
+            current = 0;
+            stage = STAGE_QUIETS;
+            [[fallthrough]];
+
+        case STAGE_QUIETS:
+            while (current < moves.size()) {
+                Move m = selectBest();
+                if (m != ttMove && !isKiller(m)) return m;
+            }
+            stage = STAGE_DONE;
+            [[fallthrough]];
 
+        case STAGE_DONE:
+            break;
+    }
+    return Move();
+}
+
+void TimeManager::start(int limitMs, uint64_t limitNodes) {
+    startTime = std::chrono::steady_clock::now();
+    hardMs = std::max(0, limitMs);
+    nodeLimit = limitNodes;
+    lastIterationEndMs = 0;
+    lastIterationMs = 0;
+    lastBestMove = Move();
+    lastScore = 0;
+    instability = 0;
+}
+
+int TimeManager::elapsedMs() const {
     auto now = std::chrono::steady_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - startTime).count();
-    return elapsed >= timeLimitMs;
+    return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(now - startTime).count());
+}
+
+bool TimeManager::outOfBudget(uint64_t nodes) const {
+    if (nodeLimit && nodes >= nodeLimit) return true;
+    return hardMs > 0 && elapsedMs() >= hardMs;
+}
+
+bool TimeManager::startNextIteration(Move bestMove, int score) {
+    int now = elapsedMs();
+    int iterationMs = now - lastIterationEndMs;
+
+    // A changed best move means the last iterations disagree. The count
+    // halves each iteration, so only recent changes matter.
+    instability /= 2;
+    if (lastBestMove.isValid() && bestMove != lastBestMove) instability += 1;
+    bool scoreDropped = lastBestMove.isValid() && score <= lastScore - TIME_SCORE_DROP;
+
+    // Predict the next iteration from the growth of this one over the last
+    double growth = lastIterationMs > 0 ? static_cast<double>(iterationMs) / lastIterationMs : 2.0;
+    growth = std::max(1.0, growth);
+
+    lastIterationEndMs = now;
+    lastIterationMs = iterationMs;
+    lastBestMove = bestMove;
+    lastScore = score;
+
+    if (hardMs == 0) return true;
+    if (now + iterationMs * growth > hardMs) return false;
+
+    int softPercent = TIME_SOFT_PERCENT +
+                      static_cast<int>(TIME_INSTABILITY_PERCENT * std::min(1.0, instability / 2)) +
+                      (scoreDropped ? TIME_SCORE_DROP_PERCENT : 0);
+    return now < static_cast<int64_t>(hardMs) * std::min(100, softPercent) / 100;
+}
+
+bool AI::checkTime(SearchThread& t) {
+    // Reading the clock every node would show up in profiles
+    if (--t.timeCheckCountdown > 0) return false;
+    t.timeCheckCountdown = TIME_CHECK_NODES;
+
+    if (pondering) return false;
+    return timeManager.outOfBudget(getNodes());
 }
 
 int AI::adjustMateScore(int score, int ply) const {
@@ -267,10 +551,13 @@ int AI::adjustMateScore(int score, int ply) const {
     return score;
 }
 
-int AI::quiescence(Game& game, int alpha, int beta, int ply) {
+template<Side S>
+int AI::quiescence(SearchThread& t, int alpha, int beta, int ply) {
     if (shouldStop) return 0;
 
-    nodes++;
+    Game& game = t.game;
+    t.countNode();
+    SEARCH_STAT(t.stats.qsNodes++);
 
     // Check for terminal state
     GameResult result = game.getResult();
@@ -285,10 +572,7 @@ int AI::quiescence(Game& game, int alpha, int beta, int ply) {
     }
 
     // Stand pat
-    int standPat = evaluate(game);
-    if (game.getSideToMove() == BLACK) {
-        standPat = -standPat;
-    }
+    int standPat = S == WHITE ? evaluate<S>(t) : -evaluate<S>(t);
 
     if (standPat >= beta) {
         return beta;
@@ -297,31 +581,19 @@ int AI::quiescence(Game& game, int alpha, int beta, int ply) {
         alpha = standPat;
     }
 
-    // Generate and search only captures
-    auto moves = game.generateLegalMoves();
-    std::vector<Move> captures;
-
-    for (const Move& m : moves) {
-        if (m.isCapture()) {
-            captures.push_back(m);
-        }
-        // Also consider promotion moves as "captures" (tactically critical)
-        else if (game.getSideToMove() == WHITE && m.to() >= A8) {
-            captures.push_back(m);
-        }
-    }
-
-    if (captures.empty()) {
+    // Out of undo stack / killer slots
+    if (ply >= MAX_PLY - 1) {
         return standPat;
     }
 
-    // Order captures
-    orderMoves(captures, game, Move(), ply);
+    // Search only captures (promotions count as captures, they are
+    // tactically critical)
+    MovePicker<S> picker(*this, t, ply);
 
-    for (const Move& move : captures) {
-        game.makeMove(move);
-        int score = -quiescence(game, -beta, -alpha, ply + 1);
-        game.unmakeMove();
+    for (Move move = picker.next(); move.isValid(); move = picker.next()) {
+        game.doMove<S>(move);
+        int score = -quiescence<~S>(t, -beta, -alpha, ply + 1);
+        game.undoMove<S>();
 
         if (shouldStop) return 0;
 
@@ -336,19 +608,23 @@ int AI::quiescence(Game& game, int alpha, int beta, int ply) {
     return alpha;
 }
 
-int AI::alphaBeta(Game& game, int depth, int alpha, int beta, int ply, PVLine& pv) {
-    pv.clear();
+template<Side S>
+int AI::alphaBeta(SearchThread& t, int depth, int alpha, int beta, int ply) {
+    t.pvLength[ply] = ply;
 
-    if (shouldStop || checkTime()) {
+    if (shouldStop || checkTime(t)) {
         shouldStop = true;
         return 0;
     }
 
-    nodes++;
+    Game& game = t.game;
+    t.countNode();
+    SEARCH_STAT(t.stats.mainNodes++);
+    CycleScope cycle(t, ply);
 
     // Update selective depth
-    if (ply > selDepth) {
-        selDepth = ply;
+    if (ply > t.selDepth) {
+        t.selDepth = ply;
     }
 
     // Check for terminal state
@@ -363,64 +639,134 @@ int AI::alphaBeta(Game& game, int depth, int alpha, int beta, int ply, PVLine& p
         return -MATE_SCORE + ply;
     }
 
+    // A repeat (possible only through null moves) made no progress, so it
+    // gets the static score. That holds only for this path, which the
+    // nodes back to the first occurrence learn through cycleFloor.
+    if (ply > 0) {
+        int distance = game.repetitionDistance();
+        if (distance > 0) {
+            t.cycleFloor = std::min(t.cycleFloor, ply - distance);
+            return S == WHITE ? evaluate<S>(t) : -evaluate<S>(t);
+        }
+    }
+
+    // Few pawns left - the tablebase knows the exact result
+    Tablebase::Result tbResult;
+    if (tablebase && ply > 0 && tablebase->probe(game, tbResult)) {
+        if (tbResult.wdl > 0) return MATE_SCORE - (ply + tbResult.dtm);
+        if (tbResult.wdl < 0) return -MATE_SCORE + (ply + tbResult.dtm);
+        return 0;
+    }
+
     // Probe transposition table
     uint64_t hash = game.getHash();
     Move ttMove;
-    TTEntry* ttEntry = probeTT(hash);
+    TTEntry ttEntry;
+    bool ttHit = probeTT(t, hash, ttEntry);
 
-    if (ttEntry && ttEntry->isValid(hash, depth)) {
-        int ttScore = ttEntry->score;
+    // No cutoffs in PV nodes, so the PV table holds the full line
+    bool pvNode = beta - alpha > 1;
+    if (ttHit && !pvNode && ttEntry.isValid(depth)) {
+        int ttScore = ttEntry.score;
         // Adjust mate scores
         if (ttScore > MATE_SCORE - 1000) ttScore -= ply;
         if (ttScore < -MATE_SCORE + 1000) ttScore += ply;
 
-        if (ttEntry->flag == TT_EXACT) {
-            pv.moves.push_back(ttEntry->bestMove);
-            pv.score = ttScore;
+        if (ttEntry.flag == TT_EXACT) {
             return ttScore;
         }
-        if (ttEntry->flag == TT_BETA && ttScore >= beta) {
+        if (ttEntry.flag == TT_BETA && ttScore >= beta) {
             return ttScore;
         }
-        if (ttEntry->flag == TT_ALPHA && ttScore <= alpha) {
+        if (ttEntry.flag == TT_ALPHA && ttScore <= alpha) {
             return ttScore;
         }
     }
-    if (ttEntry) {
-        ttMove = ttEntry->bestMove;
+    if (ttHit) {
+        ttMove = ttEntry.bestMove;
+        SEARCH_STAT(t.stats.ttCollisions += ttMove.isValid() && !game.isLegalMove<S>(ttMove));
     }
 
     // Leaf node - go to quiescence
-    if (depth <= 0) {
-        return quiescence(game, alpha, beta, ply);
+    if (depth <= 0 || ply >= MAX_PLY - 1) {
+        return quiescence<S>(t, alpha, beta, ply);
     }
 
-    // Generate moves
-    auto moves = game.generateLegalMoves();
-    if (moves.empty()) {
-        return 0;  // Stalemate (shouldn't happen if game not over)
+    // Null move: if passing the turn still fails high, some real move will
+    // too. Not in PV nodes, never twice in a row, and not near mate scores.
+    if (!pvNode && options.nullMove[S] && depth >= NULL_MOVE_MIN_DEPTH &&
+        ply >= t.nullMoveMinPly && !game.lastMoveWasNull() &&
+        std::abs(beta) < MATE_SCORE - 1000) {
+        int staticEval = S == WHITE ? evaluate<S>(t) : -evaluate<S>(t);
+
+        if (staticEval >= beta) {
+            int R = NULL_MOVE_R + depth / NULL_MOVE_R_DEPTH;
+            game.doNullMove();
+            int score = -alphaBeta<~S>(t, depth - 1 - R, -beta, -beta + 1, ply + 1);
+            game.undoMove<S>();
+            if (shouldStop) return 0;
+
+            if (score >= beta) {
+                // A mate found by passing isn't proven
+                if (score >= MATE_SCORE - 1000) score = beta;
+
+                if (!options.verifyNullMove || depth < NULL_MOVE_VERIFY_DEPTH) {
+                    return score;
+                }
+
+                // Verify with a reduced search that can't null move again
+                // for most of its depth, which catches zugzwang
+                int savedMinPly = t.nullMoveMinPly;
+                t.nullMoveMinPly = ply + 3 * (depth - R) / 4;
+                int verified = alphaBeta<S>(t, depth - R, beta - 1, beta, ply);
+                t.nullMoveMinPly = savedMinPly;
+                if (shouldStop) return 0;
+                if (verified >= beta) return score;
+            }
+        }
     }
 
-    // Order moves
-    orderMoves(moves, game, ttMove, ply);
+    MovePicker<S> picker(*this, t, ttMove, ply);
 
     Move bestMove;
     int bestScore = -INFINITY_SCORE;
     TTFlag ttFlag = TT_ALPHA;
-    PVLine childPV;
+    int moveCount = 0;
 
-    for (size_t i = 0; i < moves.size(); i++) {
-        const Move& move = moves[i];
+    for (Move move = picker.next(); move.isValid(); move = picker.next()) {
+        if (shouldStop) return 0;
+        moveCount++;
+
+        // PVS: the first move gets the full window, later ones only have to
+        // prove they are no better than alpha and are re-searched if not
+        game.doMove<S>(move);
+        int score;
+        if (moveCount == 1) {
+            score = -alphaBeta<~S>(t, depth - 1, -beta, -alpha, ply + 1);
+        } else {
+            // LMR: late quiets are first searched shallower, the more so
+            // the later they come in the history-ordered list. Pawn pushes
+            // to the last ranks are never reduced.
+            int reduction = 0;
+            if (options.lmr[S] && depth >= LMR_MIN_DEPTH && moveCount > LMR_MIN_MOVES &&
+                picker.isQuiet() && !(S == WHITE && rankOf(move.to()) >= 5)) {
+                reduction = lmrReduction(depth, moveCount);
+                int history = t.history[move.from()][move.to()];
+                if (history == 0) reduction++;                   // Never caused a cutoff
+                else if (history >= LMR_HISTORY_GOOD) reduction--;
+                if (pvNode) reduction--;
+                reduction = std::max(0, std::min(reduction, depth - 2));
+            }
 
-        // Check time/stop more frequently
-        if (shouldStop || (i % 4 == 0 && checkTime())) {
-            shouldStop = true;
-            return 0;
+            score = -alphaBeta<~S>(t, depth - 1 - reduction, -alpha - 1, -alpha, ply + 1);
+            if (reduction > 0 && score > alpha && !shouldStop) {
+                score = -alphaBeta<~S>(t, depth - 1, -alpha - 1, -alpha, ply + 1);
+            }
+            if (score > alpha && score < beta && !shouldStop) {
+                score = -alphaBeta<~S>(t, depth - 1, -beta, -alpha, ply + 1);
+            }
         }
-
-        game.makeMove(move);
-        int score = -alphaBeta(game, depth - 1, -beta, -alpha, ply + 1, childPV);
-        game.unmakeMove();
+        game.undoMove<S>();
 
         if (shouldStop) return 0;
 
@@ -432,28 +778,25 @@ int AI::alphaBeta(Game& game, int depth, int alpha, int beta, int ply, PVLine& p
                 alpha = score;
                 ttFlag = TT_EXACT;
 
-                // Update PV
-                pv.moves.clear();
-                pv.moves.push_back(move);
-                for (const Move& m : childPV.moves) {
-                    pv.moves.push_back(m);
-                }
-                pv.score = score;
+                // Update PV: this move followed by the child's line
+                t.updatePV(ply, move);
 
                 if (score >= beta) {
                     ttFlag = TT_BETA;
+                    SEARCH_STAT(t.stats.betaCutoffs++);
+                    SEARCH_STAT(t.stats.cutoffsAt[std::min(moveCount, SearchStats::CUTOFF_SLOTS) - 1]++);
 
                     // Update killer moves
-                    if (!move.isCapture() && ply < 128) {
-                        if (killers[ply][0] != move) {
-                            killers[ply][1] = killers[ply][0];
-                            killers[ply][0] = move;
+                    if (!move.isCapture() && ply < MAX_PLY) {
+                        if (t.killers[ply][0] != move) {
+                            t.killers[ply][1] = t.killers[ply][0];
+                            t.killers[ply][0] = move;
                         }
                     }
 
                     // Update history
                     if (!move.isCapture()) {
-                        history[move.from()][move.to()] += depth * depth;
+                        t.history[move.from()][move.to()] += depth * depth;
                     }
 
                     break;  // Beta cutoff
@@ -462,24 +805,279 @@ int AI::alphaBeta(Game& game, int depth, int alpha, int beta, int ply, PVLine& p
         }
     }
 
-    // Store in TT
-    int storeScore = bestScore;
-    if (storeScore > MATE_SCORE - 1000) storeScore += ply;
-    if (storeScore < -MATE_SCORE + 1000) storeScore -= ply;
-    storeTT(hash, storeScore, depth, ttFlag, bestMove);
+    if (moveCount == 0) {
+        return 0;  // Stalemate (shouldn't happen if game not over)
+    }
+
+    // Store in TT, unless a repeat below went back above this node and
+    // made the score path dependent
+    if (!cycle.pathDependent()) {
+        int storeScore = bestScore;
+        if (storeScore > MATE_SCORE - 1000) storeScore += ply;
+        if (storeScore < -MATE_SCORE + 1000) storeScore -= ply;
+        bool evicted = tt.store(hash, storeScore, depth, ttFlag, bestMove);
+        SEARCH_STAT(t.stats.ttStores++);
+        SEARCH_STAT(t.stats.ttOverwrites += evicted);
+    }
 
     return bestScore;
 }
 
+void AI::helperSearch(SearchThread& t) {
+    // Odd helpers start one ply deeper so the threads spread over
+    // neighbouring iterations instead of all searching the same one
+    for (int depth = 1 + (t.id & 1); depth <= maxDepth && !shouldStop; depth++) {
+        t.selDepth = 0;
+        if (t.game.getSideToMove() == WHITE) {
+            alphaBeta<WHITE>(t, depth, -INFINITY_SCORE, INFINITY_SCORE, 0);
+        } else {
+            alphaBeta<BLACK>(t, depth, -INFINITY_SCORE, INFINITY_SCORE, 0);
+        }
+    }
+}
+
 SearchInfo AI::search(Game& game) {
     searching = true;
     shouldStop = false;
-    nodes = 0;
-    ttHits = 0;
-    selDepth = 0;
-    ttAge++;
+    return iterativeDeepening(game);
+}
 
-    startTime = std::chrono::steady_clock::now();
+void AI::startSearch(const Game& game) {
+    waitSearch();
+
+    // Set both flags before the thread starts, so isSearching() is true as
+    // soon as this returns and an early stopSearch() isn't lost
+    backgroundGame = game;
+    searching = true;
+    shouldStop = false;
+    backgroundThread = std::thread([this]() {
+        backgroundResult = iterativeDeepening(backgroundGame);
+    });
+}
+
+void AI::startPonder(const Game& game) {
+    waitSearch();
+    pondering = true;
+    startSearch(game);
+}
+
+SearchInfo AI::waitSearch() {
+    if (backgroundThread.joinable()) {
+        backgroundThread.join();
+    }
+    return backgroundResult;
+}
+
+BatchResult AI::analyzePosition(SearchThread& t, int depth, uint64_t nodeBudget) {
+    Game& game = t.game;
+    int sign = game.getSideToMove() == WHITE ? 1 : -1;
+    uint64_t startNodes = t.nodes.load(std::memory_order_relaxed);
+    BatchResult result = {0, 0, 0, Move(), 0};
+
+    switch (game.getResult()) {
+        case GameResult::WHITE_WINS_PROMOTION:
+        case GameResult::WHITE_WINS_CAPTURE: result.score = MATE_SCORE; return result;
+        case GameResult::BLACK_WINS: result.score = -MATE_SCORE; return result;
+        case GameResult::DRAW_STALEMATE: return result;
+        case GameResult::ONGOING: break;
+    }
+
+    MoveList legalMoves = game.generateLegalMoves();
+    orderMoves(t, legalMoves, Move(), 0);
+    std::vector<RootMove> rootMoves;
+    for (Move move : legalMoves) {
+        rootMoves.push_back({move, -INFINITY_SCORE, -INFINITY_SCORE, {}});
+    }
+
+    // Plain iterative deepening, single line and full window: positions
+    // are unrelated, so there is no previous score to aspire around
+    for (int d = 1; d <= depth && !shouldStop; d++) {
+        searchRoot(t, rootMoves, 0, d, -INFINITY_SCORE, INFINITY_SCORE);
+        if (shouldStop) break;
+        sortRootMoves(rootMoves.begin(), rootMoves.end());
+
+        result.score = sign * rootMoves[0].score;
+        result.depth = d;
+        result.bestMove = rootMoves[0].move;
+
+        if (std::abs(rootMoves[0].score) > MATE_SCORE - 1000) break;
+        if (nodeBudget && t.nodes.load(std::memory_order_relaxed) - startNodes >= nodeBudget) break;
+    }
+
+    result.nodes = t.nodes.load(std::memory_order_relaxed) - startNodes;
+    return result;
+}
+
+int AI::analyzeBatch(const std::vector<BatchPosition>& positions, int depth,
+                     uint64_t nodesPerPosition, const BatchCallback& cb) {
+    searching = true;
+    shouldStop = false;
+    return runBatch(positions, depth, nodesPerPosition, cb);
+}
+
+int AI::runBatch(const std::vector<BatchPosition>& positions, int depth,
+                 uint64_t nodesPerPosition, const BatchCallback& cb) {
+    for (auto& t : threads) {
+        t->nodes = 0;
+        t->ttHits = 0;
+        t->stats = SearchStats();
+        t->timeCheckCountdown = TIME_CHECK_NODES;
+        t->cycleFloor = NO_CYCLE;
+    }
+    tt.newSearch();
+    timeManager.start(timeLimitMs, 0);
+
+    std::atomic<size_t> next{0};
+    std::atomic<int> analyzed{0};
+    std::mutex callbackMutex;
+
+    auto work = [&](SearchThread& t) {
+        for (size_t i = next++; i < positions.size() && !shouldStop; i = next++) {
+            const BatchPosition& p = positions[i];
+            BatchResult result;
+
+            // More than eight pawns could overflow the move lists. A pawn on
+            // rank 8 is a finished game, which analyzePosition() reports.
+            if ((p.pawns & p.queen) || (p.pawns & RANK_1) || Game::popCount(p.pawns) > 8 ||
+                Game::popCount(p.queen) > 1 || (p.side != WHITE && p.side != BLACK)) {
+                result = {0, 0, -1, Move(), 0};
+            } else {
+                t.game.setPosition(p.pawns, p.queen, p.side);
+                t.clearHeuristics();
+                t.selDepth = 0;
+                result = analyzePosition(t, depth, nodesPerPosition);
+                if (shouldStop && result.depth == 0 && result.nodes > 0) break;
+            }
+
+            result.index = static_cast<int>(i);
+            analyzed++;
+            if (cb) {
+                std::lock_guard<std::mutex> lock(callbackMutex);
+                cb(result);
+            }
+        }
+    };
+
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < threads.size(); i++) {
+        helpers.emplace_back(work, std::ref(*threads[i]));
+    }
+    work(*threads[0]);
+    for (auto& h : helpers) {
+        h.join();
+    }
+
+    searching = false;
+    return analyzed;
+}
+
+void AI::startBatch(std::vector<BatchPosition> positions, int depth,
+                    uint64_t nodesPerPosition, BatchCallback cb) {
+    waitSearch();
+
+    backgroundBatch = std::move(positions);
+    searching = true;
+    shouldStop = false;
+    backgroundThread = std::thread([this, depth, nodesPerPosition, cb]() {
+        runBatch(backgroundBatch, depth, nodesPerPosition, cb);
+    });
+}
+
+// Search root moves [pvIdx, end) inside [alpha, beta], PVS style: the first
+// with the full window, the rest with a zero window and a re-search when
+// they beat alpha. Lines before pvIdx are already reported this iteration
+// and excluded, which is what makes each MultiPV line a real score. Moves
+// that fail low get -INFINITY_SCORE so a stable sort keeps them in order.
+template<Side S>
+int AI::searchRoot(SearchThread& t, std::vector<RootMove>& rootMoves, size_t pvIdx,
+                   int depth, int alpha, int beta) {
+    int bestScore = -INFINITY_SCORE;
+
+    for (size_t i = pvIdx; i < rootMoves.size() && !shouldStop; i++) {
+        RootMove& rm = rootMoves[i];
+
+        t.game.doMove<S>(rm.move);
+        int score;
+        if (i == pvIdx) {
+            score = -alphaBeta<~S>(t, depth - 1, -beta, -alpha, 1);
+        } else {
+            score = -alphaBeta<~S>(t, depth - 1, -alpha - 1, -alpha, 1);
+            if (score > alpha && score < beta && !shouldStop) {
+                score = -alphaBeta<~S>(t, depth - 1, -beta, -alpha, 1);
+            }
+        }
+        t.game.undoMove<S>();
+
+        if (shouldStop) break;
+
+        bestScore = std::max(bestScore, score);
+        if (i == pvIdx || score > alpha) {
+            rm.score = score;
+            rm.pv.clear();
+            rm.pv.push(rm.move);
+            for (int j = 1; j < t.pvLength[1]; j++) {
+                rm.pv.push(t.pvTable[1][j]);
+            }
+        } else {
+            rm.score = -INFINITY_SCORE;
+        }
+
+        if (score > alpha) {
+            alpha = score;
+            if (score >= beta) break;  // Fail high, the window gets widened
+        }
+    }
+
+    return bestScore;
+}
+
+int AI::searchRoot(SearchThread& t, std::vector<RootMove>& rootMoves, size_t pvIdx,
+                   int depth, int alpha, int beta) {
+    return t.game.getSideToMove() == WHITE
+        ? searchRoot<WHITE>(t, rootMoves, pvIdx, depth, alpha, beta)
+        : searchRoot<BLACK>(t, rootMoves, pvIdx, depth, alpha, beta);
+}
+
+bool AI::probeBook(const Game& game, SearchInfo& info) {
+    OpeningBook::Entry entry;
+    if (!book || !book->probe(game, entry)) return false;
+
+    // The PV follows the book for as long as it has the positions
+    PVLine line;
+    Game pos = game;
+    OpeningBook::Entry next = entry;
+    do {
+        line.moves.push(next.move);
+        pos.makeMove(next.move);
+    } while (static_cast<int>(line.moves.size()) < MAX_PLY / 2 && pos.getResult() == GameResult::ONGOING &&
+             book->probe(pos, next));
+
+    int sign = game.getSideToMove() == WHITE ? 1 : -1;
+    line.score = sign * entry.score;
+    line.depth = entry.depth;
+
+    info.depth = entry.depth;
+    info.score = line.score;
+    info.pvLines.push(line);
+    bestMoveFound = entry.move;
+    return true;
+}
+
+SearchInfo AI::iterativeDeepening(Game& game) {
+    for (auto& t : threads) {
+        t->nodes = 0;
+        t->ttHits = 0;
+        t->stats = SearchStats();
+        t->timeCheckCountdown = TIME_CHECK_NODES;
+        t->cycleFloor = NO_CYCLE;
+        t->selDepth = 0;
+        t->game = game;
+    }
+    tt.newSearch();
+
+    SearchThread& main = *threads[0];
+
+    timeManager.start(timeLimitMs, nodeLimit);
 
     SearchInfo info;
     info.depth = 0;
@@ -490,119 +1088,123 @@ SearchInfo AI::search(Game& game) {
     info.timeMs = 0;
     info.pvLines.clear();
 
-    auto rootMoves = game.generateLegalMoves();
-    if (rootMoves.empty()) {
+    MoveList legalMoves = game.generateLegalMoves();
+    if (legalMoves.empty()) {
+        bestMoveFound = Move();
         searching = false;
         return info;
     }
 
-    // Initialize PV lines for MultiPV
-    std::vector<PVLine> pvLines(std::min(multiPV, (int)rootMoves.size()));
-
-    // Iterative deepening
-    for (int depth = 1; depth <= maxDepth && !shouldStop; depth++) {
-        selDepth = 0;
-
-        // For MultiPV, we need to search each root move separately
-        std::vector<std::pair<int, Move>> rootScores;
-
-        // First pass: get scores for all root moves
-        PVLine tempPV;
-        int alpha = -INFINITY_SCORE;
-        int beta = INFINITY_SCORE;
-
-        // Order root moves based on previous iteration
-        orderMoves(rootMoves, game, (pvLines[0].moves.empty() ? Move() : pvLines[0].moves[0]), 0);
-
-        for (size_t i = 0; i < rootMoves.size() && !shouldStop; i++) {
-            const Move& move = rootMoves[i];
+    // Book moves answer single-line searches instantly. MultiPV analysis
+    // still searches, the book only knows one move per position.
+    if (multiPV == 1 && probeBook(game, info)) {
+        if (callback) callback(info);
+        searching = false;
+        return info;
+    }
 
-            game.makeMove(move);
-            int score = -alphaBeta(game, depth - 1, -beta, -alpha, 1, tempPV);
-            game.unmakeMove();
+    // Root moves start in move-ordering order, then stay sorted by the
+    // previous iteration's scores
+    orderMoves(main, legalMoves, Move(), 0);
+    std::vector<RootMove> rootMoves;
+    for (Move move : legalMoves) {
+        rootMoves.push_back({move, -INFINITY_SCORE, -INFINITY_SCORE, {}});
+    }
+    bestMoveFound = rootMoves[0].move;
 
-            if (!shouldStop) {
-                rootScores.push_back({score, move});
+    // Lazy SMP: helpers search the same root independently and share
+    // results through the transposition table
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < threads.size(); i++) {
+        helpers.emplace_back(&AI::helperSearch, this, std::ref(*threads[i]));
+    }
 
-                if (score > alpha) {
-                    alpha = score;
-                    bestMoveFound = move;
-                }
-            }
-        }
+    size_t lineCount = std::min<size_t>(multiPV, rootMoves.size());
+    uint64_t prevNodes = 0;
 
-        if (shouldStop && depth > 1) {
-            break;
+    // Iterative deepening
+    for (int depth = 1; depth <= maxDepth && !shouldStop; depth++) {
+        main.selDepth = 0;
+        for (RootMove& rm : rootMoves) {
+            rm.prevScore = rm.score;
         }
 
-        // Sort root moves by score
-        std::sort(rootScores.begin(), rootScores.end(),
-                  [](const auto& a, const auto& b) { return a.first > b.first; });
-
-        // Build MultiPV lines
-        pvLines.clear();
-        for (size_t i = 0; i < std::min((size_t)multiPV, rootScores.size()); i++) {
-            Move rootMove = rootScores[i].second;
-
-            // Skip invalid moves
-            if (!rootMove.isValid()) {
-                continue;
+        // MultiPV: line N searches all moves except the N-1 lines above it
+        for (size_t pvIdx = 0; pvIdx < lineCount && !shouldStop; pvIdx++) {
+            // Aspiration window around this line's previous score, widened
+            // in stages on a fail high or low until the score lands inside
+            int prevScore = rootMoves[pvIdx].prevScore;
+            int alpha = -INFINITY_SCORE;
+            int beta = INFINITY_SCORE;
+            int delta = ASPIRATION_WINDOW;
+            if (depth >= ASPIRATION_MIN_DEPTH && std::abs(prevScore) < MATE_SCORE - 1000) {
+                alpha = prevScore - delta;
+                beta = prevScore + delta;
             }
 
-            PVLine line;
-            line.score = rootScores[i].first;
-            line.depth = depth;
-            line.moves.push_back(rootMove);
+            while (true) {
+                int score = searchRoot(main, rootMoves, pvIdx, depth, alpha, beta);
 
-            // Get continuation from TT
-            Game tempGame = game;
-            if (!tempGame.makeMove(rootMove)) {
-                continue;  // Skip if move fails
-            }
+                // Best of the remaining moves moves up to pvIdx
+                sortRootMoves(rootMoves.begin() + pvIdx, rootMoves.end());
+                if (shouldStop) break;
 
-            // Follow TT to build PV
-            for (int j = 0; j < depth - 1 && !tempGame.isGameOver(); j++) {
-                TTEntry* entry = probeTT(tempGame.getHash());
-                if (entry && entry->bestMove.isValid()) {
-                    if (tempGame.isLegalMove(entry->bestMove)) {
-                        line.moves.push_back(entry->bestMove);
-                        tempGame.makeMove(entry->bestMove);
-                    } else {
-                        break;
-                    }
+                if (score <= alpha) {
+                    beta = (alpha + beta) / 2;
+                    alpha = std::max(score - delta, -INFINITY_SCORE);
+                } else if (score >= beta) {
+                    beta = std::min(score + delta, INFINITY_SCORE);
                 } else {
                     break;
                 }
+
+                delta += delta / 2;
+                if (delta > ASPIRATION_MAX_WINDOW) {
+                    alpha = -INFINITY_SCORE;
+                    beta = INFINITY_SCORE;
+                }
             }
 
-            pvLines.push_back(line);
+            // The first line of a finished search is already better informed
+            // than the previous iteration, even if the rest gets cut off
+            if (pvIdx == 0 && !shouldStop) {
+                bestMoveFound = rootMoves[0].move;
+            }
         }
 
-        // Skip update if we have no results
-        if (pvLines.empty() || pvLines[0].moves.empty()) {
-            continue;
+        if (shouldStop && depth > 1) {
+            break;
+        }
+        if (rootMoves[0].score == -INFINITY_SCORE) {
+            continue;  // Stopped before the first line had a score
         }
 
         // Update info
-        auto now = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - startTime).count();
+        int elapsed = timeManager.elapsedMs();
+
+        uint64_t nodes = getNodes();
+        if (depth < MAX_PLY) SEARCH_STAT(main.stats.iterationNodes[depth] = nodes - prevNodes);
+        prevNodes = nodes;
+
+        // Scores for display are from White's perspective
+        int sign = game.getSideToMove() == WHITE ? 1 : -1;
 
         info.depth = depth;
-        info.selDepth = selDepth;
-        info.score = game.getSideToMove() == WHITE ? pvLines[0].score : -pvLines[0].score;
+        info.selDepth = main.selDepth;
+        info.score = sign * rootMoves[0].score;
         info.nodes = nodes;
         info.timeMs = elapsed;
         info.nps = elapsed > 0 ? (nodes * 1000) / elapsed : nodes;
-        info.pvLines = pvLines;
-
-        // Adjust scores for display (from White's perspective)
-        for (auto& pv : info.pvLines) {
-            if (game.getSideToMove() == BLACK) {
-                pv.score = -pv.score;
-            }
+        info.pvLines.clear();
+        for (size_t i = 0; i < lineCount; i++) {
+            if (rootMoves[i].score == -INFINITY_SCORE) break;  // Not searched before a stop
+            PVLine line;
+            line.moves = rootMoves[i].pv;
+            line.score = sign * rootMoves[i].score;
+            line.depth = depth;
+            info.pvLines.push(line);
         }
-
-        bestMoveFound = pvLines[0].moves.empty() ? rootMoves[0] : pvLines[0].moves[0];
+        bestMoveFound = rootMoves[0].move;
 
         // Call callback
         if (callback) {
@@ -617,6 +1219,16 @@ SearchInfo AI::search(Game& game) {
                 break;
             }
         }
+
+        // Soft time limit. A ponder search keeps going until ponderHit().
+        if (!timeManager.startNextIteration(rootMoves[0].move, rootMoves[0].score) && !pondering) {
+            break;
+        }
+    }
+
+    shouldStop = true;
+    for (auto& h : helpers) {
+        h.join();
     }
 
     searching = false;
@@ -2,38 +2,30 @@
 #define AI_H
 
 #include "game.h"
+#include "tt.h"
+#include "tablebase.h"
+#include "book.h"
+#include <algorithm>
 #include <vector>
 #include <array>
 #include <chrono>
 #include <functional>
 #include <atomic>
+#include <memory>
+#include <thread>
+#include <mutex>
 
 namespace PigsAndFarmers {
 
-// Transposition table entry types
-enum TTFlag : uint8_t {
-    TT_EXACT = 0,
-    TT_ALPHA = 1,  // Upper bound
-    TT_BETA = 2    // Lower bound
-};
-
-// Transposition table entry
-struct TTEntry {
-    uint64_t hash;
-    int16_t score;
-    int8_t depth;
-    uint8_t flag;
-    Move bestMove;
-    uint8_t age;
+// Most PV lines a MultiPV search reports
+constexpr int MAX_MULTIPV = 10;
 
-    bool isValid(uint64_t h, int d) const {
-        return hash == h && depth >= d;
-    }
-};
+// Principal Variation line. Fixed capacity like everything the search
+// fills in, so copying lines into SearchInfo never allocates.
+using PVMoves = FixedList<Move, MAX_PLY>;
 
-// Principal Variation line
 struct PVLine {
-    std::vector<Move> moves;
+    PVMoves moves;
     int score;
     int depth;
 
@@ -44,6 +36,15 @@ struct PVLine {
     }
 };
 
+// Root move with its score and line from the current iteration, and the
+// score from the previous one (centres the aspiration window)
+struct RootMove {
+    Move move;
+    int score;
+    int prevScore;
+    PVMoves pv;
+};
+
 // Search info returned to UI
 struct SearchInfo {
     int depth;
@@ -52,7 +53,7 @@ struct SearchInfo {
     uint64_t nodes;
     uint64_t nps;
     int timeMs;
-    std::vector<PVLine> pvLines;  // MultiPV lines
+    FixedList<PVLine, MAX_MULTIPV> pvLines;  // MultiPV lines
 
     bool isMate() const { return score > 90000 || score < -90000; }
     int mateIn() const {
@@ -65,29 +66,258 @@ struct SearchInfo {
 // Callback for search updates
 using SearchCallback = std::function<void(const SearchInfo&)>;
 
+// Batch analysis input, as for Game::setPosition()
+struct BatchPosition {
+    Bitboard pawns;
+    Bitboard queen;
+    Side side;
+};
+
+// Batch analysis result for positions[index]. Score is from White's
+// perspective like SearchInfo; depth is 0 for a finished game (no move)
+// and -1 for an invalid position.
+struct BatchResult {
+    int index;
+    int score;
+    int depth;
+    Move bestMove;
+    uint64_t nodes;
+};
+
+using BatchCallback = std::function<void(const BatchResult&)>;
+
+// Static evaluation outside the search, for tuning the weights (eval.h)
+namespace Eval {
+
+// How often each weight applies to the position, signed so that dot() with
+// PARAMS is the engine's static score, White's point of view. False (and
+// all zero) for a finished game, stalemate included.
+bool features(Bitboard pawns, Bitboard queen, Side side, EvalParams& counts);
+int dot(const EvalParams& weights, const EvalParams& counts);
+
+// Static scores of many positions under any weights; won games score as
+// mates and stalemates as draws
+std::vector<int> evaluateBatch(const std::vector<BatchPosition>& positions,
+                               const EvalParams& weights);
+
+} // namespace Eval
+
+// Forward pruning switches, per side ([WHITE], [BLACK]). Null moves assume
+// that passing is never better than the best move, which zugzwang breaks:
+// blocked pawns often have only bad moves, so the pawn side defaults off.
+struct SearchOptions {
+    std::array<bool, 2> nullMove = {false, true};
+    std::array<bool, 2> lmr = {true, true};
+    bool verifyNullMove = true;  // Re-search deep null-move cutoffs without null moves
+};
+
+// Search profiling counters, per thread while searching and summed by
+// AI::getSearchStats(). Only counted in builds with -DSEARCH_STATS
+// (make bench-stats): the timers alone cost more than what they time, so
+// the normal build leaves them all zero.
+struct SearchStats {
+#ifdef SEARCH_STATS
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+    static constexpr int CUTOFF_SLOTS = 8;  // Last slot: move 8 or later
+
+    uint64_t mainNodes = 0;
+    uint64_t qsNodes = 0;
+
+    // Beta cutoffs by the number of the move that caused them
+    uint64_t betaCutoffs = 0;
+    std::array<uint64_t, CUTOFF_SLOTS> cutoffsAt{};
+
+    uint64_t ttProbes = 0;
+    uint64_t ttHits = 0;
+    uint64_t ttCollisions = 0;  // Hits whose move is illegal here: another position's entry
+    uint64_t ttStores = 0;
+    uint64_t ttOverwrites = 0;  // Stores that evicted another position's entry
+
+    // Nodes searched by each iteration of the main search
+    std::array<uint64_t, MAX_PLY> iterationNodes{};
+
+    uint64_t movegenNs = 0;
+    uint64_t evalNs = 0;
+    uint64_t orderingNs = 0;
+
+    void add(const SearchStats& other);
+
+    double firstMoveCutoffRate() const {
+        return betaCutoffs ? static_cast<double>(cutoffsAt[0]) / betaCutoffs : 0.0;
+    }
+    // Nodes of iteration depth over those of the one before, 0 if unknown
+    double branchingFactor(int depth) const {
+        if (depth < 2 || depth >= MAX_PLY || iterationNodes[depth - 1] == 0) return 0.0;
+        return static_cast<double>(iterationNodes[depth]) / iterationNodes[depth - 1];
+    }
+};
+
+// Time and node budget for one search. The time limit is hard: the
+// search stops within one clock check of it. Below it a soft limit (half
+// of it) decides whether another iteration is worth starting. It stretches
+// while the best move keeps changing or the score drops. An iteration that
+// the last branching factor predicts would run past the hard limit isn't
+// started at all, since it couldn't finish.
+class TimeManager {
+public:
+    void start(int limitMs, uint64_t limitNodes);
+    int elapsedMs() const;
+
+    // Hard limits, polled by the search threads
+    bool outOfBudget(uint64_t nodes) const;
+
+    // Called by the main thread after each completed iteration with its
+    // best move and score: whether to start the next one
+    bool startNextIteration(Move bestMove, int score);
+
+private:
+    std::chrono::steady_clock::time_point startTime;
+    int hardMs = 0;  // 0 = no time limit
+    uint64_t nodeLimit = 0;  // 0 = no node limit
+
+    int lastIterationEndMs = 0;
+    int lastIterationMs = 0;
+    Move lastBestMove;
+    int lastScore = 0;
+    double instability = 0;  // Decaying count of best move changes
+};
+
+// SearchThread::cycleFloor when no repeat was found
+constexpr int NO_CYCLE = MAX_PLY;
+
+// Per-thread search state. Each Lazy SMP helper searches its own copy of
+// the position with its own killers and history; only the transposition
+// table is shared.
+struct SearchThread {
+    int id = 0;
+    Game game;
+    std::atomic<uint64_t> nodes{0};  // Read by the main thread for reporting
+    uint64_t ttHits = 0;
+    int selDepth = 0;
+
+    // Killer moves (2 killers per ply)
+    std::array<std::array<Move, 2>, MAX_PLY> killers;
+
+    // History heuristic
+    std::array<std::array<int, 64>, 64> history;
+
+    // Null moves are off below this ply while a verification search runs
+    int nullMoveMinPly = 0;
+
+    // Lowest ply that a repeated position below the current node goes back
+    // to (NO_CYCLE if none). Scores of the nodes in between depend on the
+    // path that led to them, so they aren't stored in the TT.
+    int cycleFloor = NO_CYCLE;
+
+    // Pawn structure cache, never cleared: entries depend only on the pawns
+    PawnHashTable pawnHash;
+
+    // Triangular PV table: pvTable[ply][ply..pvLength[ply]) is the best line
+    // found from ply, filled in as scores back up
+    std::array<std::array<Move, MAX_PLY>, MAX_PLY> pvTable;
+    std::array<int, MAX_PLY> pvLength;
+
+    // Mutable so the move picker, which only reads the thread, can count
+    mutable SearchStats stats;
+
+    // Nodes until this thread next looks at the clock
+    int timeCheckCountdown = 0;
+
+    void clearHeuristics();
+
+    void updatePV(int ply, Move move) {
+        pvTable[ply][ply] = move;
+        for (int i = ply + 1; i < pvLength[ply + 1]; i++) {
+            pvTable[ply][i] = pvTable[ply + 1][i];
+        }
+        pvLength[ply] = pvLength[ply + 1];
+    }
+
+    // Only this thread writes its counter, so a relaxed load/store is enough
+    // and avoids a locked add per node
+    void countNode() {
+        nodes.store(nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
 class AI {
+    template<Side> friend class MovePicker;
+
 public:
     AI();
     ~AI();
 
     // Configuration
-    void setMultiPV(int n) { multiPV = std::min(n, 10); }
+    void setMultiPV(int n) { multiPV = std::clamp(n, 1, MAX_MULTIPV); }
     void setMaxDepth(int d) { maxDepth = d; }
     void setTimeLimit(int ms) { timeLimitMs = ms; }
+    // Stop after about this many nodes (0 = no limit), for reproducible
+    // fixed-work searches. Checked like the time limit.
+    void setNodeLimit(uint64_t nodes) { nodeLimit = nodes; }
     void setCallback(SearchCallback cb) { callback = cb; }
+    void setThreads(int n);
+    void setHashSizeMB(int mb) { tt.resize(mb); }
+    int getHashSizeMB() const { return tt.getSizeMB(); }
+    void setTablebase(const Tablebase* tb) { tablebase = tb; }  // Not owned
+    void setBook(const OpeningBook* b) { book = b; }             // Not owned
+    void setOptions(const SearchOptions& opts) { options = opts; }
+    const SearchOptions& getOptions() const { return options; }
+    int getThreads() const { return static_cast<int>(threads.size()); }
 
     // Search
     SearchInfo search(Game& game);
-    void stopSearch() { shouldStop = true; }
+    void stopSearch() { shouldStop = true; pondering = false; }
     bool isSearching() const { return searching; }
 
+    // Background search on a copy of the position, leaving the caller free
+    // to handle stop and new-position requests. The callback runs on the
+    // search thread. waitSearch() joins it and returns the final info, so
+    // call it once isSearching() turns false or after stopSearch().
+    void startSearch(const Game& game);
+    SearchInfo waitSearch();
+
+    // Pondering: a background search of the position after the expected
+    // reply, run on the opponent's time. It ignores the time limit until
+    // ponderHit() says the reply was played; from then on it is a normal
+    // search whose time limit counts from the start of pondering, so it
+    // usually answers at once. On a different reply, stopSearch() and
+    // waitSearch() drop it and the TT keeps what it learned. Keep the
+    // result of a ponder search that ends early until ponderHit() too.
+    void startPonder(const Game& game);
+    void ponderHit() { pondering = false; }
+    bool isPondering() const { return pondering; }
+
+    // Analyze each position to depth, not starting another iteration once
+    // it has used nodesPerPosition nodes (0 = no limit). The search threads
+    // take positions from a shared queue and share the TT. Results reach
+    // the callback one at a time, in completion order, from whichever
+    // thread finished them. A time limit covers the whole batch. Returns
+    // the number analyzed, fewer after stopSearch(). startBatch() runs it in the background like
+    // startSearch(); join it with waitSearch().
+    int analyzeBatch(const std::vector<BatchPosition>& positions, int depth,
+                     uint64_t nodesPerPosition, const BatchCallback& cb);
+    void startBatch(std::vector<BatchPosition> positions, int depth,
+                    uint64_t nodesPerPosition, BatchCallback cb);
+
     // Clear state
     void clearHash();
+
+    // Transposition table snapshots (see TranspositionTable::serialize),
+    // only while no search is running
+    std::vector<uint8_t> saveTT() const { return tt.serialize(); }
+    bool loadTT(const uint8_t* data, size_t size) { return tt.load(data, size); }
     void clearKillers();
 
-    // Stats
-    uint64_t getNodes() const { return nodes; }
-    uint64_t getTTHits() const { return ttHits; }
+    // Stats (summed over all threads)
+    uint64_t getNodes() const;
+    uint64_t getTTHits() const;
+
+    // Profiling counters of the last search or batch (see SearchStats),
+    // only while no search is running
+    SearchStats getSearchStats() const;
 
     // Get best move directly
     Move getBestMove() const { return bestMoveFound; }
@@ -97,57 +327,158 @@ private:
     int multiPV = 3;
     int maxDepth = 64;
     int timeLimitMs = 0;  // 0 = infinite
+    uint64_t nodeLimit = 0;  // 0 = infinite
     SearchCallback callback;
+    SearchOptions options;
 
     // Search state
     std::atomic<bool> shouldStop;
     std::atomic<bool> searching;
-    uint64_t nodes;
-    uint64_t ttHits;
-    int selDepth;
+    std::atomic<bool> pondering;
     Move bestMoveFound;
 
+    // Background search
+    std::thread backgroundThread;
+    Game backgroundGame;
+    SearchInfo backgroundResult{};
+    std::vector<BatchPosition> backgroundBatch;
+
     // Timing
-    std::chrono::steady_clock::time_point startTime;
+    TimeManager timeManager;
 
-    // Transposition table
-    static constexpr size_t TT_SIZE = 1 << 20;  // ~1M entries
-    std::vector<TTEntry> transTable;
-    uint8_t ttAge;
+    // Transposition table (shared by all threads)
+    TranspositionTable tt;
 
-    // Killer moves (2 killers per ply, max 128 ply)
-    std::array<std::array<Move, 2>, 128> killers;
+    // Exact scores for low pawn counts (optional)
+    const Tablebase* tablebase = nullptr;
 
-    // History heuristic
-    std::array<std::array<int, 64>, 64> history;
+    // Precomputed opening moves (optional), played without searching
+    const OpeningBook* book = nullptr;
+
+    // threads[0] is the main thread, the rest are Lazy SMP helpers
+    std::vector<std::unique_ptr<SearchThread>> threads;
 
-    // Evaluation
-    int evaluate(const Game& game) const;
+    // Evaluation, White's point of view. The search calls the side-specialized
+    // versions, the plain ones dispatch on the side to move.
+    template<Side S> int evaluate(SearchThread& t) const;
+    int evaluate(SearchThread& t) const;
+    int pawnScore(SearchThread& t) const;
 
     // Search functions
-    int alphaBeta(Game& game, int depth, int alpha, int beta, int ply, PVLine& pv);
-    int quiescence(Game& game, int alpha, int beta, int ply);
+    SearchInfo iterativeDeepening(Game& game);
+    bool probeBook(const Game& game, SearchInfo& info);
+    // Templated on the side to move, so each side's node loop is compiled
+    // separately and the two alternate without runtime side checks
+    template<Side S>
+    int searchRoot(SearchThread& t, std::vector<RootMove>& rootMoves, size_t pvIdx,
+                   int depth, int alpha, int beta);
+    int searchRoot(SearchThread& t, std::vector<RootMove>& rootMoves, size_t pvIdx,
+                   int depth, int alpha, int beta);
+    template<Side S> int alphaBeta(SearchThread& t, int depth, int alpha, int beta, int ply);
+    template<Side S> int quiescence(SearchThread& t, int alpha, int beta, int ply);
+    void helperSearch(SearchThread& t);
+    BatchResult analyzePosition(SearchThread& t, int depth, uint64_t nodeBudget);
+    int runBatch(const std::vector<BatchPosition>& positions, int depth,
+                 uint64_t nodesPerPosition, const BatchCallback& cb);
 
     // Move ordering
-    void orderMoves(std::vector<Move>& moves, const Game& game, Move ttMove, int ply) const;
-    int scoreMove(Move move, const Game& game, Move ttMove, int ply) const;
+    void orderMoves(const SearchThread& t, MoveList& moves, Move ttMove, int ply) const;
+    template<Side S> int scoreMove(const SearchThread& t, Move move, Move ttMove, int ply) const;
 
     // TT operations
-    void storeTT(uint64_t hash, int score, int depth, TTFlag flag, Move bestMove);
-    TTEntry* probeTT(uint64_t hash);
+    bool probeTT(SearchThread& t, uint64_t hash, TTEntry& entry);
 
     // Utility
-    bool checkTime();
+    bool checkTime(SearchThread& t);
     int adjustMateScore(int score, int ply) const;
 };
 
+// Staged move picker. Yields the TT move before anything is generated,
+// then captures and promotions, the killers, and finally quiets by
+// history, selecting the best remaining move each call instead of sorting.
+// Nodes that cut off early never generate or score the later stages.
+// S is the side to move.
+template<Side S>
+class MovePicker {
+public:
+    // Main search: all stages
+    MovePicker(const AI& ai, const SearchThread& t, Move ttMove, int ply);
+    // Quiescence: captures and promotions only
+    MovePicker(const AI& ai, const SearchThread& t, int ply);
+
+    // Next move to search, or an invalid Move when exhausted
+    Move next();
+
+    // True while next() is handing out plain quiets: no TT move, capture,
+    // promotion or killer
+    bool isQuiet() const { return stage == STAGE_QUIETS; }
+
+private:
+    enum Stage {
+        STAGE_TT_MOVE,
+        STAGE_GEN_CAPTURES,
+        STAGE_CAPTURES,
+        STAGE_KILLERS,
+        STAGE_GEN_QUIETS,
+        STAGE_QUIETS,
+        STAGE_DONE
+    };
+
+    const AI& ai;
+    const SearchThread& thread;
+    const Game& game;
+    Move ttMove;
+    int ply;
+    bool capturesOnly;
+    Stage stage;
+
+    MoveList moves;
+    std::array<int, MAX_MOVES> scores;
+    size_t current;
+    int killerIndex;
+
+    void scoreMoves();
+    Move selectBest();
+    bool isTactical(Move move) const;
+    bool isKiller(Move move) const;
+};
+
 // Score constants
 constexpr int MATE_SCORE = 100000;
+static_assert(MATE_SCORE == TT_MATE_SCORE, "TT score encoding assumes MATE_SCORE");
+constexpr int MAX_THREADS = 64;
 constexpr int INFINITY_SCORE = 1000000;
 
-// Piece values for evaluation
-constexpr int PAWN_VALUE = 100;
-constexpr int QUEEN_VALUE = 900;
+// Aspiration windows: start this wide around the previous iteration's
+// score, grow by half on each fail, give up on the window past the max
+constexpr int ASPIRATION_WINDOW = 40;
+constexpr int ASPIRATION_MIN_DEPTH = 4;
+constexpr int ASPIRATION_MAX_WINDOW = 500;
+
+// Null-move pruning: reduction is NULL_MOVE_R plus one per NULL_MOVE_R_DEPTH
+// plies of depth, and cutoffs at NULL_MOVE_VERIFY_DEPTH or more are verified
+constexpr int NULL_MOVE_MIN_DEPTH = 3;
+constexpr int NULL_MOVE_R = 2;
+constexpr int NULL_MOVE_R_DEPTH = 6;
+constexpr int NULL_MOVE_VERIFY_DEPTH = 8;
+
+// Late move reductions for quiets after the first LMR_MIN_MOVES moves, one
+// ply less for moves whose history reaches LMR_HISTORY_GOOD
+constexpr int LMR_MIN_DEPTH = 3;
+constexpr int LMR_MIN_MOVES = 3;
+constexpr int LMR_HISTORY_GOOD = 1000;
+
+// Time management: each thread reads the clock every TIME_CHECK_NODES
+// nodes. The soft limit is TIME_SOFT_PERCENT of the hard one, stretched by
+// up to TIME_INSTABILITY_PERCENT for best move changes and
+// TIME_SCORE_DROP_PERCENT after a drop of TIME_SCORE_DROP or more.
+constexpr int TIME_CHECK_NODES = 1024;
+constexpr int TIME_SOFT_PERCENT = 50;
+constexpr int TIME_INSTABILITY_PERCENT = 60;
+constexpr int TIME_SCORE_DROP_PERCENT = 40;
+constexpr int TIME_SCORE_DROP = 30;
+
+// Promotion value (the piece values are Eval::PARAMS weights)
 constexpr int PROMOTION_BONUS = 50000;  // Near-winning
 
 } // namespace PigsAndFarmers
@@ -0,0 +1,111 @@
+#include "book.h"
+#include "tt.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace PigsAndFarmers {
+
+namespace {
+
+constexpr char BOOK_MAGIC[4] = { 'P', 'F', 'O', 'B' };
+constexpr uint8_t BOOK_VERSION = 2;
+constexpr size_t BOOK_HEADER_SIZE = 12;
+constexpr size_t BOOK_ENTRY_SIZE = 16;
+
+void putLE(uint8_t* p, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+uint64_t getLE(const uint8_t* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) value |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return value;
+}
+
+bool keyLess(const OpeningBook::Entry& a, const OpeningBook::Entry& b) {
+    return a.key < b.key;
+}
+
+} // namespace
+
+void OpeningBook::add(uint64_t key, Move move, int score, int depth) {
+    Entry entry = {key, move, score, depth};
+    auto it = std::lower_bound(entries.begin(), entries.end(), entry, keyLess);
+    if (it != entries.end() && it->key == key) {
+        *it = entry;
+    } else {
+        entries.insert(it, entry);
+    }
+}
+
+std::vector<uint8_t> OpeningBook::serialize() const {
+    std::vector<uint8_t> data(BOOK_HEADER_SIZE + entries.size() * BOOK_ENTRY_SIZE, 0);
+    std::memcpy(data.data(), BOOK_MAGIC, 4);
+    data[4] = BOOK_VERSION;
+    putLE(&data[8], entries.size(), 4);
+
+    uint8_t* p = data.data() + BOOK_HEADER_SIZE;
+    for (const Entry& e : entries) {
+        putLE(p, e.key, 8);
+        putLE(p + 8, e.move.data, 2);
+        putLE(p + 10, static_cast<uint16_t>(encodeStoredScore(e.score)), 2);
+        p[12] = static_cast<uint8_t>(e.depth);
+        p += BOOK_ENTRY_SIZE;
+    }
+    return data;
+}
+
+bool OpeningBook::load(const uint8_t* data, size_t size) {
+    if (size < BOOK_HEADER_SIZE || std::memcmp(data, BOOK_MAGIC, 4) != 0 ||
+        data[4] != BOOK_VERSION) {
+        return false;
+    }
+
+    size_t count = getLE(data + 8, 4);
+    if (size != BOOK_HEADER_SIZE + count * BOOK_ENTRY_SIZE) return false;
+
+    std::vector<Entry> loaded(count);
+    const uint8_t* p = data + BOOK_HEADER_SIZE;
+    for (Entry& e : loaded) {
+        e.key = getLE(p, 8);
+        e.move.data = static_cast<uint16_t>(getLE(p + 8, 2));
+        e.score = decodeStoredScore(static_cast<int16_t>(getLE(p + 10, 2)));
+        e.depth = p[12];
+        p += BOOK_ENTRY_SIZE;
+    }
+    if (!std::is_sorted(loaded.begin(), loaded.end(), keyLess)) return false;
+
+    entries = std::move(loaded);
+    return true;
+}
+
+bool OpeningBook::loadFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                              std::istreambuf_iterator<char>());
+    return load(data.data(), data.size());
+}
+
+bool OpeningBook::saveFile(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+
+    std::vector<uint8_t> data = serialize();
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return static_cast<bool>(out);
+}
+
+bool OpeningBook::probe(const Game& game, Entry& entry) const {
+    Entry target = {game.getHash(), Move(), 0, 0};
+    auto it = std::lower_bound(entries.begin(), entries.end(), target, keyLess);
+    if (it == entries.end() || it->key != target.key) return false;
+    if (!game.isLegalMove(it->move)) return false;
+
+    entry = *it;
+    return true;
+}
+
+} // namespace PigsAndFarmers
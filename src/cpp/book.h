@@ -0,0 +1,49 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include "game.h"
+#include <vector>
+#include <string>
+
+namespace PigsAndFarmers {
+
+// Opening book: best moves for positions near the start, found offline by
+// deep searches (tools/bookgen.cpp) and keyed by Game::getHash().
+//
+// File format (little endian):
+//   char[4] "PFOB", uint8 version, uint8[3] reserved, uint32 count,
+//   then count 16-byte entries sorted by key:
+//   uint64 key, uint16 move, int16 score, uint8 depth, uint8[3] reserved.
+// Scores are from the side to move's point of view, like the TT, and mate
+// scores are stored as +-(32767 - plies to mate).
+class OpeningBook {
+public:
+    struct Entry {
+        uint64_t key;
+        Move move;
+        int score;
+        int depth;
+    };
+
+    // Add or replace a position's entry (generator side; sorted on save)
+    void add(uint64_t key, Move move, int score, int depth);
+
+    bool load(const uint8_t* data, size_t size);
+    bool loadFile(const std::string& path);
+    bool saveFile(const std::string& path) const;
+    std::vector<uint8_t> serialize() const;
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+
+    // Book entry for the position. A move that isn't legal here (a key
+    // collision) counts as a miss.
+    bool probe(const Game& game, Entry& entry) const;
+
+private:
+    std::vector<Entry> entries;  // Sorted by key
+};
+
+} // namespace PigsAndFarmers
+
+#endif // BOOK_H
@@ -0,0 +1,130 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+#include <array>
+#include <cstdint>
+
+namespace PigsAndFarmers {
+
+// Evaluation terms that Game maintains incrementally in make/unmake. Pawn-only
+// terms live in the pawn hash below, and the queen-dependent terms (threats,
+// mobility, blocked files) are computed lazily in AI::evaluate.
+struct EvalState {
+    int queenPsq;     // Queen placement (centrality, rank), White's view
+};
+
+// Pawn material, advancement and connected pairs, keyed by Game::getPawnKey().
+// Pawns only change on half the plies and the same sets recur all over the
+// tree, so each search thread caches them.
+struct PawnEntry {
+    uint64_t key;
+    int score;
+};
+
+constexpr int PAWN_HASH_SIZE = 4096;  // Entries per thread (64KB)
+
+class PawnHashTable {
+public:
+    PawnHashTable() { clear(); }
+
+    // Key 0 is the empty pawn set, which is terminal and never probed, so
+    // zeroed entries read as empty
+    void clear() { entries.fill(PawnEntry{0, 0}); }
+
+    PawnEntry& operator[](uint64_t key) { return entries[key & (PAWN_HASH_SIZE - 1)]; }
+
+private:
+    std::array<PawnEntry, PAWN_HASH_SIZE> entries;
+};
+
+// Evaluation weights. Every term of AI::evaluate is one of these times a
+// count (see Eval::features in ai.h), so the score is linear in them and
+// tools/tune.cpp can fit them to game results. Ranks and files count from
+// 0 (rank 1, file a); queen-to-move tables are indexed [S == BLACK].
+struct EvalParams {
+    int pawnValue;
+    int queenValue;
+    int connectedPair;                  // +5 for each pawn of the pair
+    int blockedFile;                    // Pawn with the queen ahead on its file
+    int queenMobility;
+    int queenThreat;                    // Per pawn the queen attacks
+    int tempo;
+    std::array<int, 8> pawnRank;        // Advancement, steeper near promotion
+    std::array<int, 8> queenFile;       // Queen wants to be central...
+    std::array<int, 8> queenRank;       // ...and low on the board to block pawns
+    // Advancement bonus lost by an attacked pawn: most of it if the queen
+    // is to move (she will likely capture it), a quarter if White can react
+    std::array<std::array<int, 8>, 2> threatLoss;
+};
+
+// Calls f(name, value) for every weight, in declaration order; tuning and
+// dot products go through this so the field list is written once
+template <typename Params, typename F>
+constexpr void forEachParam(Params& p, F f) {
+    f("pawnValue", p.pawnValue);
+    f("queenValue", p.queenValue);
+    f("connectedPair", p.connectedPair);
+    f("blockedFile", p.blockedFile);
+    f("queenMobility", p.queenMobility);
+    f("queenThreat", p.queenThreat);
+    f("tempo", p.tempo);
+    for (auto& v : p.pawnRank) f("pawnRank", v);
+    for (auto& v : p.queenFile) f("queenFile", v);
+    for (auto& v : p.queenRank) f("queenRank", v);
+    for (auto& row : p.threatLoss) {
+        for (auto& v : row) f("threatLoss", v);
+    }
+}
+
+constexpr int countParams() {
+    EvalParams p{};
+    int n = 0;
+    forEachParam(p, [&](const char*, int&) { n++; });
+    return n;
+}
+
+constexpr int EVAL_PARAM_COUNT = countParams();
+
+namespace Eval {
+
+// The weights compiled into the engine. `make tune` prints a replacement
+// in this layout.
+constexpr EvalParams PARAMS = {
+    100,  // pawnValue
+    900,  // queenValue
+    10,   // connectedPair
+    20,   // blockedFile
+    2,    // queenMobility
+    10,   // queenThreat
+    10,   // tempo
+    { 0, 5, 10, 20, 40, 130, 260, 670 },          // pawnRank
+    { -5, -10, -15, -20, -15, -10, -5, 0 },       // queenFile
+    { -24, -21, -18, -15, -12, -9, -6, -3 },      // queenRank
+    {{ { 0, 2, 3, 5, 10, 33, 65, 168 },           // threatLoss, White to move
+       { 0, 4, 8, 15, 30, 98, 195, 503 } }}       // threatLoss, queen to move
+};
+
+template <typename F>
+constexpr std::array<int, 64> squareTable(F f) {
+    std::array<int, 64> table = {};
+    for (int sq = 0; sq < 64; sq++) table[sq] = f(sq);
+    return table;
+}
+
+constexpr std::array<int, 64> PAWN_PSQ = squareTable(
+    [](int sq) { return PARAMS.pawnRank[sq >> 3]; });
+
+constexpr std::array<int, 64> QUEEN_PSQ = squareTable(
+    [](int sq) { return PARAMS.queenFile[sq & 7] + PARAMS.queenRank[sq >> 3]; });
+
+// Bonus lost for an attacked pawn, indexed [queen to move][square]
+constexpr std::array<std::array<int, 64>, 2> PAWN_THREAT_LOSS = {
+    squareTable([](int sq) { return PARAMS.threatLoss[0][sq >> 3]; }),
+    squareTable([](int sq) { return PARAMS.threatLoss[1][sq >> 3]; })
+};
+
+} // namespace Eval
+
+} // namespace PigsAndFarmers
+
+#endif // EVAL_H
@@ -1,79 +1,209 @@
 #include "game.h"
-#include <random>
 #include <algorithm>
 #include <sstream>
 #include <cstring>
+#include <cstdlib>
 
 namespace PigsAndFarmers {
 
-// Static member initialization
-std::array<uint64_t, 64> Game::pawnKeys;
-std::array<uint64_t, 64> Game::queenKeys;
-uint64_t Game::sideKey;
-bool Game::zobristInitialized = false;
+namespace {
 
-// Attack tables
-std::array<Bitboard, 64> kingAttacks;
-std::array<Bitboard, 64> knightAttacks;
+// (file, rank) steps
+constexpr int ROOK_DIRECTIONS[4][2] = { {0, 1}, {0, -1}, {1, 0}, {-1, 0} };
+constexpr int BISHOP_DIRECTIONS[4][2] = { {1, 1}, {-1, 1}, {1, -1}, {-1, -1} };
+constexpr int KING_STEPS[8][2] = {
+    {-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}
+};
+constexpr int KNIGHT_STEPS[8][2] = {
+    {-2, -1}, {-2, 1}, {-1, -2}, {-1, 2}, {1, -2}, {1, 2}, {2, -1}, {2, 1}
+};
 
-void initAttackTables() {
-    // Initialize king attacks (not used in this game but useful)
+// Walks each ray from sq up to and including the first occupied square
+constexpr Bitboard slidingAttacks(int sq, Bitboard occupied, const int (&directions)[4][2]) {
+    Bitboard attacks = 0;
+    for (const auto& d : directions) {
+        int file = fileOf(sq) + d[0];
+        int rank = rankOf(sq) + d[1];
+        while (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
+            attacks |= squareBB(makeSquare(file, rank));
+            if (occupied & squareBB(makeSquare(file, rank))) break;
+            file += d[0];
+            rank += d[1];
+        }
+    }
+    return attacks;
+}
+
+constexpr std::array<Bitboard, 64> stepAttacks(const int (&steps)[8][2]) {
+    std::array<Bitboard, 64> table = {};
     for (int sq = 0; sq < 64; sq++) {
-        Bitboard attacks = 0;
-        int rank = rankOf(sq);
-        int file = fileOf(sq);
-
-        for (int dr = -1; dr <= 1; dr++) {
-            for (int df = -1; df <= 1; df++) {
-                if (dr == 0 && df == 0) continue;
-                int nr = rank + dr;
-                int nf = file + df;
-                if (nr >= 0 && nr < 8 && nf >= 0 && nf < 8) {
-                    attacks |= squareBB(makeSquare(nf, nr));
-                }
+        for (const auto& s : steps) {
+            int file = fileOf(sq) + s[0];
+            int rank = rankOf(sq) + s[1];
+            if (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
+                table[sq] |= squareBB(makeSquare(file, rank));
             }
         }
-        kingAttacks[sq] = attacks;
     }
+    return table;
+}
 
-    // Knight attacks (not used but included for completeness)
-    const int knightOffsets[8][2] = {
-        {-2, -1}, {-2, 1}, {-1, -2}, {-1, 2},
-        {1, -2}, {1, 2}, {2, -1}, {2, 1}
-    };
+// Multipliers that map every relevant occupancy of a square to a slot of
+// its slice without destructive collisions, found by a sparse random
+// search. Unused with USE_PEXT. `make bench-reference` checks them: perft
+// must match the loop attacks.
+constexpr uint64_t ROOK_MAGIC_NUMBERS[64] = {
+    0x0A80004000801220ULL, 0x8040004010002008ULL, 0x2080200010008008ULL, 0x1100100008210004ULL,
+    0xC200209084020008ULL, 0x2100010004000208ULL, 0x0400081000822421ULL, 0x0200010422048844ULL,
+    0x0800800080400024ULL, 0x0001402000401000ULL, 0x3000801000802001ULL, 0x4400800800100083ULL,
+    0x0904802402480080ULL, 0x4040800400020080ULL, 0x0018808042000100ULL, 0x4040800080004100ULL,
+    0x0040048001458024ULL, 0x00A0004000205000ULL, 0x3100808010002000ULL, 0x4825010010000820ULL,
+    0x5004808008000401ULL, 0x2024818004000A00ULL, 0x0005808002000100ULL, 0x2100060004806104ULL,
+    0x0080400880008421ULL, 0x4062220600410280ULL, 0x010A004A00108022ULL, 0x0000100080080080ULL,
+    0x0021000500080010ULL, 0x0044000202001008ULL, 0x0000100400080102ULL, 0xC020128200040545ULL,
+    0x0080002000400040ULL, 0x0000804000802004ULL, 0x0000120022004080ULL, 0x010A386103001001ULL,
+    0x9010080080800400ULL, 0x8440020080800400ULL, 0x0004228824001001ULL, 0x000000490A000084ULL,
+    0x0080002000504000ULL, 0x200020005000C000ULL, 0x0012088020420010ULL, 0x0010010080080800ULL,
+    0x0085001008010004ULL, 0x0002000204008080ULL, 0x0040413002040008ULL, 0x0000304081020004ULL,
+    0x0080204000800080ULL, 0x3008804000290100ULL, 0x1010100080200080ULL, 0x2008100208028080ULL,
+    0x5000850800910100ULL, 0x8402019004680200ULL, 0x0120911028020400ULL, 0x0000008044010200ULL,
+    0x0020850200244012ULL, 0x0020850200244012ULL, 0x0000102001040841ULL, 0x140900040A100021ULL,
+    0x000200282410A102ULL, 0x000200282410A102ULL, 0x000200282410A102ULL, 0x4048240043802106ULL,
+};
+constexpr uint64_t BISHOP_MAGIC_NUMBERS[64] = {
+    0x40106000A1160020ULL, 0x0020010250810120ULL, 0x2010010220280081ULL, 0x002806004050C040ULL,
+    0x0002021018000000ULL, 0x2001112010000400ULL, 0x0881010120218080ULL, 0x1030820110010500ULL,
+    0x0000120222042400ULL, 0x2000020404040044ULL, 0x8000480094208000ULL, 0x0003422A02000001ULL,
+    0x000A220210100040ULL, 0x8004820202226000ULL, 0x0018234854100800ULL, 0x0100004042101040ULL,
+    0x0004001004082820ULL, 0x0010000810010048ULL, 0x1014004208081300ULL, 0x2080818802044202ULL,
+    0x0040880C00A00100ULL, 0x0080400200522010ULL, 0x0001000188180B04ULL, 0x0080249202020204ULL,
+    0x1004400004100410ULL, 0x00013100A0022206ULL, 0x2148500001040080ULL, 0x4241080011004300ULL,
+    0x4020848004002000ULL, 0x10101380D1004100ULL, 0x0008004422020284ULL, 0x01010A1041008080ULL,
+    0x0808080400082121ULL, 0x0808080400082121ULL, 0x0091128200100C00ULL, 0x0202200802010104ULL,
+    0x8C0A020200440085ULL, 0x01A0008080B10040ULL, 0x0889520080122800ULL, 0x100902022202010AULL,
+    0x04081A0816002000ULL, 0x0000681208005000ULL, 0x8170840041008802ULL, 0x0A00004200810805ULL,
+    0x0830404408210100ULL, 0x2602208106006102ULL, 0x1048300680802628ULL, 0x2602208106006102ULL,
+    0x0602010120110040ULL, 0x0941010801043000ULL, 0x000040440A210428ULL, 0x0008240020880021ULL,
+    0x0400002012048200ULL, 0x00AC102001210220ULL, 0x0220021002009900ULL, 0x84440C080A013080ULL,
+    0x0001008044200440ULL, 0x0004C04410841000ULL, 0x2000500104011130ULL, 0x1A0C010011C20229ULL,
+    0x0044800112202200ULL, 0x0434804908100424ULL, 0x0300404822C08200ULL, 0x48081010008A2A80ULL,
+};
+
+// Shared storage for all squares' sliding attacks (fancy magic layout),
+// filled on first use
+std::array<Bitboard, 0x19000> rookTable;
+std::array<Bitboard, 0x1480> bishopTable;
+
+constexpr std::array<Magic, 64> makeMagics(const uint64_t (&numbers)[64],
+                                           const int (&directions)[4][2], Bitboard* table) {
+    std::array<Magic, 64> magics = {};
+    size_t offset = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        Magic& m = magics[sq];
+
+        // Board edges don't affect the attack set unless we stand on them
+        Bitboard edges = ((RANK_1 | RANK_8) & ~(RANK_1 << (8 * rankOf(sq)))) |
+                         ((FILE_A | FILE_H) & ~(FILE_A << fileOf(sq)));
+        m.mask = slidingAttacks(sq, 0, directions) & ~edges;
+        m.magic = numbers[sq];
+        m.shift = 64 - __builtin_popcountll(m.mask);
+        m.attacks = table + offset;
+        offset += size_t(1) << __builtin_popcountll(m.mask);
+    }
+    return magics;
+}
 
+void fillAttacks(const std::array<Magic, 64>& magics, const int (&directions)[4][2]) {
     for (int sq = 0; sq < 64; sq++) {
-        Bitboard attacks = 0;
-        int rank = rankOf(sq);
-        int file = fileOf(sq);
-
-        for (int i = 0; i < 8; i++) {
-            int nr = rank + knightOffsets[i][0];
-            int nf = file + knightOffsets[i][1];
-            if (nr >= 0 && nr < 8 && nf >= 0 && nf < 8) {
-                attacks |= squareBB(makeSquare(nf, nr));
-            }
-        }
-        knightAttacks[sq] = attacks;
+        const Magic& m = magics[sq];
+
+        // Every subset of the mask (Carry-Rippler)
+        Bitboard b = 0;
+        do {
+            m.attacks[m.index(b)] = slidingAttacks(sq, b, directions);
+            b = (b - m.mask) & m.mask;
+        } while (b);
     }
 }
 
-void Game::initZobrist() {
-    if (zobristInitialized) return;
+// std::mt19937_64 as a constexpr, so the Zobrist keys are compile-time
+// constants. Same seed and sequence as before: book files and TT snapshots
+// keyed by these hashes stay valid.
+class ConstexprMt64 {
+public:
+    constexpr explicit ConstexprMt64(uint64_t seed) : state(), index(N) {
+        state[0] = seed;
+        for (int i = 1; i < N; i++) {
+            state[i] = 6364136223846793005ULL * (state[i - 1] ^ (state[i - 1] >> 62)) + i;
+        }
+    }
+
+    constexpr uint64_t operator()() {
+        if (index == N) twist();
+        uint64_t y = state[index++];
+        y ^= (y >> 29) & 0x5555555555555555ULL;
+        y ^= (y << 17) & 0x71D67FFFEDA60000ULL;
+        y ^= (y << 37) & 0xFFF7EEE000000000ULL;
+        return y ^ (y >> 43);
+    }
+
+private:
+    static constexpr int N = 312;
+    static constexpr int M = 156;
+    uint64_t state[N];
+    int index;
+
+    constexpr void twist() {
+        for (int i = 0; i < N; i++) {
+            uint64_t x = (state[i] & 0xFFFFFFFF80000000ULL) | (state[(i + 1) % N] & 0x7FFFFFFFULL);
+            uint64_t xA = (x >> 1) ^ ((x & 1) ? 0xB5026F5AA96619E9ULL : 0);
+            state[i] = state[(i + M) % N] ^ xA;
+        }
+        index = 0;
+    }
+};
 
-    std::mt19937_64 rng(0x1234567890ABCDEFULL);
+struct ZobristKeys {
+    std::array<uint64_t, 64> pawn = {};
+    std::array<uint64_t, 64> queen = {};
+    uint64_t side = 0;
+};
 
+constexpr ZobristKeys makeZobristKeys() {
+    ZobristKeys keys;
+    ConstexprMt64 rng(0x1234567890ABCDEFULL);
     for (int sq = 0; sq < 64; sq++) {
-        pawnKeys[sq] = rng();
-        queenKeys[sq] = rng();
+        keys.pawn[sq] = rng();
+        keys.queen[sq] = rng();
     }
-    sideKey = rng();
+    keys.side = rng();
+    return keys;
+}
+
+constexpr ZobristKeys ZOBRIST = makeZobristKeys();
+
+} // namespace
 
-    zobristInitialized = true;
+// Attack tables
+constexpr std::array<Bitboard, 64> kingAttacks = stepAttacks(KING_STEPS);
+constexpr std::array<Bitboard, 64> knightAttacks = stepAttacks(KNIGHT_STEPS);
+constexpr std::array<Magic, 64> rookMagics =
+    makeMagics(ROOK_MAGIC_NUMBERS, ROOK_DIRECTIONS, rookTable.data());
+constexpr std::array<Magic, 64> bishopMagics =
+    makeMagics(BISHOP_MAGIC_NUMBERS, BISHOP_DIRECTIONS, bishopTable.data());
+
+void initAttackTables() {
+    // A function-local static, so racing first calls from several threads
+    // fill the slices once
+    static const bool filled = [] {
+        fillAttacks(rookMagics, ROOK_DIRECTIONS);
+        fillAttacks(bishopMagics, BISHOP_DIRECTIONS);
+        return true;
+    }();
+    (void)filled;
 }
 
 Game::Game() {
-    initZobrist();
     initAttackTables();
     reset();
 }
@@ -87,14 +217,18 @@ void Game::reset() {
 
     sideToMove = WHITE;
     ply = 0;
+    undoTop = 0;
 
     // Calculate initial hash
-    hash = 0;
+    pawnKey = 0;
     for (int sq = A2; sq <= H2; sq++) {
-        hash ^= pawnKeys[sq];
+        pawnKey ^= ZOBRIST.pawn[sq];
     }
-    hash ^= queenKeys[D8];
-    // White to move, so no sideKey XOR needed initially
+    hash = pawnKey ^ ZOBRIST.queen[D8];
+    // White to move, so no side key XOR needed initially
+
+    computeEvalState();
+    result = computeResult();
 }
 
 void Game::setPosition(Bitboard p, Bitboard q, Side side) {
@@ -102,25 +236,34 @@ void Game::setPosition(Bitboard p, Bitboard q, Side side) {
     queen = q;
     sideToMove = side;
     ply = 0;
+    undoTop = 0;
     moveHistory.clear();
 
     // Recalculate hash
-    hash = 0;
+    pawnKey = 0;
     Bitboard bb = pawns;
     while (bb) {
         int sq = lsb(bb);
-        hash ^= pawnKeys[sq];
+        pawnKey ^= ZOBRIST.pawn[sq];
         bb &= bb - 1;
     }
+    hash = pawnKey;
     bb = queen;
     while (bb) {
         int sq = lsb(bb);
-        hash ^= queenKeys[sq];
+        hash ^= ZOBRIST.queen[sq];
         bb &= bb - 1;
     }
     if (sideToMove == BLACK) {
-        hash ^= sideKey;
+        hash ^= ZOBRIST.side;
     }
+
+    computeEvalState();
+    result = computeResult();
+}
+
+void Game::computeEvalState() {
+    evalState.queenPsq = queen ? Eval::QUEEN_PSQ[lsb(queen)] : 0;
 }
 
 int Game::popCount(Bitboard bb) {
@@ -140,112 +283,53 @@ int Game::lsb(Bitboard bb) {
 #endif
 }
 
-Bitboard Game::rookAttacks(int sq, Bitboard occupied) {
-    Bitboard attacks = 0;
-    int rank = rankOf(sq);
-    int file = fileOf(sq);
-
-    // North
-    for (int r = rank + 1; r < 8; r++) {
-        attacks |= squareBB(makeSquare(file, r));
-        if (occupied & squareBB(makeSquare(file, r))) break;
-    }
-    // South
-    for (int r = rank - 1; r >= 0; r--) {
-        attacks |= squareBB(makeSquare(file, r));
-        if (occupied & squareBB(makeSquare(file, r))) break;
-    }
-    // East
-    for (int f = file + 1; f < 8; f++) {
-        attacks |= squareBB(makeSquare(f, rank));
-        if (occupied & squareBB(makeSquare(f, rank))) break;
-    }
-    // West
-    for (int f = file - 1; f >= 0; f--) {
-        attacks |= squareBB(makeSquare(f, rank));
-        if (occupied & squareBB(makeSquare(f, rank))) break;
-    }
-
-    return attacks;
+Bitboard Game::rookAttacksSlow(int sq, Bitboard occupied) {
+    return slidingAttacks(sq, occupied, ROOK_DIRECTIONS);
 }
 
-Bitboard Game::bishopAttacks(int sq, Bitboard occupied) {
-    Bitboard attacks = 0;
-    int rank = rankOf(sq);
-    int file = fileOf(sq);
-
-    // NE
-    for (int r = rank + 1, f = file + 1; r < 8 && f < 8; r++, f++) {
-        attacks |= squareBB(makeSquare(f, r));
-        if (occupied & squareBB(makeSquare(f, r))) break;
-    }
-    // NW
-    for (int r = rank + 1, f = file - 1; r < 8 && f >= 0; r++, f--) {
-        attacks |= squareBB(makeSquare(f, r));
-        if (occupied & squareBB(makeSquare(f, r))) break;
-    }
-    // SE
-    for (int r = rank - 1, f = file + 1; r >= 0 && f < 8; r--, f++) {
-        attacks |= squareBB(makeSquare(f, r));
-        if (occupied & squareBB(makeSquare(f, r))) break;
-    }
-    // SW
-    for (int r = rank - 1, f = file - 1; r >= 0 && f >= 0; r--, f--) {
-        attacks |= squareBB(makeSquare(f, r));
-        if (occupied & squareBB(makeSquare(f, r))) break;
-    }
-
-    return attacks;
+Bitboard Game::bishopAttacksSlow(int sq, Bitboard occupied) {
+    return slidingAttacks(sq, occupied, BISHOP_DIRECTIONS);
 }
 
-Bitboard Game::queenAttacks(int sq, Bitboard occupied) {
-    return rookAttacks(sq, occupied) | bishopAttacks(sq, occupied);
-}
-
-void Game::generatePawnMoves(std::vector<Move>& moves) const {
-    Bitboard occupied = pawns | queen;
-
-    Bitboard bb = pawns;
-    while (bb) {
-        int from = lsb(bb);
-        bb &= bb - 1;
-
-        int rank = rankOf(from);
-        int file = fileOf(from);
-
-        // Single push (forward = +8 for white)
-        int to = from + 8;
-        if (to < 64 && !(occupied & squareBB(to))) {
-            moves.push_back(Move(from, to, QUIET));
+void Game::generatePawnMoves(MoveList& moves, GenType type) const {
+    // Setwise: each move kind is one shift and mask over all pawns, then
+    // the targets are serialized with the origin a fixed offset behind
+    Bitboard empty = ~(pawns | queen);
+    Bitboard singles = (pawns << 8) & empty;
+
+    if (type != GEN_QUIETS) {
+        // Pushes to rank 8 win the game, so they go with the captures
+        for (Bitboard bb = singles & RANK_8; bb; bb &= bb - 1) {
+            int to = lsb(bb);
+            moves.push(Move(to - 8, to, QUIET));
+        }
 
-            // Double push from rank 2
-            if (rank == 1) {
-                int to2 = from + 16;
-                if (!(occupied & squareBB(to2))) {
-                    moves.push_back(Move(from, to2, DOUBLE_PUSH));
-                }
-            }
+        // Diagonal captures of the queen, masking the files that would wrap
+        for (Bitboard bb = ((pawns & ~FILE_A) << 7) & queen; bb; bb &= bb - 1) {
+            int to = lsb(bb);
+            moves.push(Move(to - 7, to, CAPTURE));
+        }
+        for (Bitboard bb = ((pawns & ~FILE_H) << 9) & queen; bb; bb &= bb - 1) {
+            int to = lsb(bb);
+            moves.push(Move(to - 9, to, CAPTURE));
         }
+    }
 
-        // Captures (diagonal)
-        // Left capture (NW)
-        if (file > 0) {
-            int capSq = from + 7;
-            if (capSq < 64 && (queen & squareBB(capSq))) {
-                moves.push_back(Move(from, capSq, CAPTURE));
-            }
+    if (type != GEN_CAPTURES) {
+        for (Bitboard bb = singles & ~RANK_8; bb; bb &= bb - 1) {
+            int to = lsb(bb);
+            moves.push(Move(to - 8, to, QUIET));
         }
-        // Right capture (NE)
-        if (file < 7) {
-            int capSq = from + 9;
-            if (capSq < 64 && (queen & squareBB(capSq))) {
-                moves.push_back(Move(from, capSq, CAPTURE));
-            }
+
+        // Double pushes: single pushes that landed on rank 3, pushed again
+        for (Bitboard bb = ((singles & RANK_3) << 8) & empty; bb; bb &= bb - 1) {
+            int to = lsb(bb);
+            moves.push(Move(to - 16, to, DOUBLE_PUSH));
         }
     }
 }
 
-void Game::generateQueenMoves(std::vector<Move>& moves) const {
+void Game::generateQueenMoves(MoveList& moves, GenType type) const {
     if (queen == 0) return;
 
     int from = lsb(queen);
@@ -253,66 +337,142 @@ void Game::generateQueenMoves(std::vector<Move>& moves) const {
     Bitboard attacks = queenAttacks(from, occupied);
 
     // Non-captures (to empty squares)
-    Bitboard nonCaptures = attacks & ~occupied;
-    while (nonCaptures) {
-        int to = lsb(nonCaptures);
-        nonCaptures &= nonCaptures - 1;
-        moves.push_back(Move(from, to, QUIET));
+    if (type != GEN_CAPTURES) {
+        Bitboard nonCaptures = attacks & ~occupied;
+        while (nonCaptures) {
+            int to = lsb(nonCaptures);
+            nonCaptures &= nonCaptures - 1;
+            moves.push(Move(from, to, QUIET));
+        }
     }
 
     // Captures (pawns only)
-    Bitboard captures = attacks & pawns;
-    while (captures) {
-        int to = lsb(captures);
-        captures &= captures - 1;
-        moves.push_back(Move(from, to, CAPTURE));
+    if (type != GEN_QUIETS) {
+        Bitboard captures = attacks & pawns;
+        while (captures) {
+            int to = lsb(captures);
+            captures &= captures - 1;
+            moves.push(Move(from, to, CAPTURE));
+        }
     }
 }
 
-std::vector<Move> Game::generateLegalMoves() const {
-    std::vector<Move> moves;
-    moves.reserve(32);
+template<Side S>
+void Game::generateMoves(MoveList& moves, GenType type) const {
+    if constexpr (S == WHITE) {
+        generatePawnMoves(moves, type);
+    } else {
+        generateQueenMoves(moves, type);
+    }
+}
+
+template<Side S>
+void Game::generateLegalMoves(MoveList& moves) const {
+    generateMoves<S>(moves, GEN_ALL);
+}
+
+template<Side S>
+void Game::generateCaptures(MoveList& moves) const {
+    generateMoves<S>(moves, GEN_CAPTURES);
+}
+
+template<Side S>
+void Game::generateQuiets(MoveList& moves) const {
+    generateMoves<S>(moves, GEN_QUIETS);
+}
 
+void Game::generateMoves(MoveList& moves, GenType type) const {
     if (sideToMove == WHITE) {
-        generatePawnMoves(moves);
+        generateMoves<WHITE>(moves, type);
     } else {
-        generateQueenMoves(moves);
+        generateMoves<BLACK>(moves, type);
     }
+}
 
+MoveList Game::generateLegalMoves() const {
+    MoveList moves;
+    generateMoves(moves, GEN_ALL);
     return moves;
 }
 
+void Game::generateLegalMoves(MoveList& moves) const {
+    generateMoves(moves, GEN_ALL);
+}
+
+void Game::generateCaptures(MoveList& moves) const {
+    generateMoves(moves, GEN_CAPTURES);
+}
+
+void Game::generateQuiets(MoveList& moves) const {
+    generateMoves(moves, GEN_QUIETS);
+}
+
+template<Side S>
 bool Game::isLegalMove(Move move) const {
-    auto moves = generateLegalMoves();
-    for (const auto& m : moves) {
-        if (m == move) return true;
+    // Checked directly against the bitboards so TT moves and killers can be
+    // validated without generating the full move list
+    int from = move.from();
+    int to = move.to();
+    Bitboard occupied = pawns | queen;
+    Bitboard toBB = squareBB(to);
+
+    if constexpr (S == WHITE) {
+        if (!(pawns & squareBB(from))) return false;
+
+        switch (move.flags()) {
+            case QUIET:
+                return to == from + 8 && !(occupied & toBB);
+            case DOUBLE_PUSH:
+                return rankOf(from) == 1 && to == from + 16 &&
+                       !(occupied & (squareBB(from + 8) | toBB));
+            case CAPTURE:
+                return (queen & toBB) &&
+                       ((to == from + 7 && fileOf(from) > 0) ||
+                        (to == from + 9 && fileOf(from) < 7));
+            default:
+                return false;
+        }
+    } else {
+        if (!(queen & squareBB(from))) return false;
+        if (!(queenAttacks(from, occupied) & toBB)) return false;
+
+        switch (move.flags()) {
+            case QUIET:   return !(occupied & toBB);
+            case CAPTURE: return (pawns & toBB) != 0;
+            default:      return false;
+        }
     }
-    return false;
 }
 
-bool Game::makeMove(Move move) {
-    if (!isLegalMove(move)) return false;
+bool Game::isLegalMove(Move move) const {
+    return sideToMove == WHITE ? isLegalMove<WHITE>(move) : isLegalMove<BLACK>(move);
+}
 
-    UndoInfo undo;
+template<Side S>
+void Game::applyMove(Move move, UndoInfo& undo) {
     undo.move = move;
     undo.hash = hash;
+    undo.pawnKey = pawnKey;
     undo.capturedPiece = 0;
+    undo.evalState = evalState;
+    undo.result = result;
 
     int from = move.from();
     int to = move.to();
 
-    if (sideToMove == WHITE) {
+    if constexpr (S == WHITE) {
         // Pawn move
         if (move.isCapture()) {
             // Pawn captures queen
             undo.capturedPiece = queen;
-            hash ^= queenKeys[to];
+            hash ^= ZOBRIST.queen[to];
             queen = 0;
+            evalState.queenPsq = 0;
         }
 
         // Move pawn
-        hash ^= pawnKeys[from];
-        hash ^= pawnKeys[to];
+        hash ^= ZOBRIST.pawn[from] ^ ZOBRIST.pawn[to];
+        pawnKey ^= ZOBRIST.pawn[from] ^ ZOBRIST.pawn[to];
         pawns &= ~squareBB(from);
         pawns |= squareBB(to);
     } else {
@@ -320,39 +480,37 @@ bool Game::makeMove(Move move) {
         if (move.isCapture()) {
             // Queen captures pawn
             undo.capturedPiece = squareBB(to);
-            hash ^= pawnKeys[to];
+            hash ^= ZOBRIST.pawn[to];
+            pawnKey ^= ZOBRIST.pawn[to];
             pawns &= ~squareBB(to);
         }
 
         // Move queen
-        hash ^= queenKeys[from];
-        hash ^= queenKeys[to];
+        hash ^= ZOBRIST.queen[from];
+        hash ^= ZOBRIST.queen[to];
         queen &= ~squareBB(from);
         queen |= squareBB(to);
+        evalState.queenPsq = Eval::QUEEN_PSQ[to];
     }
 
-    hash ^= sideKey;
-    sideToMove = (sideToMove == WHITE) ? BLACK : WHITE;
+    hash ^= ZOBRIST.side;
+    sideToMove = ~S;
     ply++;
-
-    moveHistory.push_back(undo);
-    return true;
+    result = computeResult();
 }
 
-bool Game::unmakeMove() {
-    if (moveHistory.empty()) return false;
-
-    UndoInfo undo = moveHistory.back();
-    moveHistory.pop_back();
-
+template<Side S>
+void Game::revertMove(const UndoInfo& undo) {
     int from = undo.move.from();
     int to = undo.move.to();
 
     // Switch side back
-    sideToMove = (sideToMove == WHITE) ? BLACK : WHITE;
+    sideToMove = S;
     ply--;
 
-    if (sideToMove == WHITE) {
+    if (!undo.move.isValid()) {
+        // Null move: nothing moved
+    } else if constexpr (S == WHITE) {
         // Unmake pawn move
         pawns &= ~squareBB(to);
         pawns |= squareBB(from);
@@ -373,10 +531,114 @@ bool Game::unmakeMove() {
     }
 
     hash = undo.hash;
+    pawnKey = undo.pawnKey;
+    evalState = undo.evalState;
+    result = undo.result;
+}
+
+void Game::applyMove(Move move, UndoInfo& undo) {
+    if (sideToMove == WHITE) {
+        applyMove<WHITE>(move, undo);
+    } else {
+        applyMove<BLACK>(move, undo);
+    }
+}
+
+void Game::revertMove(const UndoInfo& undo) {
+    // The side that made the move is the one not to move now
+    if (sideToMove == BLACK) {
+        revertMove<WHITE>(undo);
+    } else {
+        revertMove<BLACK>(undo);
+    }
+}
+
+bool Game::makeMove(Move move) {
+    if (!isLegalMove(move)) return false;
+
+    UndoInfo undo;
+    applyMove(move, undo);
+    moveHistory.push_back(undo);
+    return true;
+}
+
+bool Game::unmakeMove() {
+    if (moveHistory.empty()) return false;
+
+    revertMove(moveHistory.back());
+    moveHistory.pop_back();
     return true;
 }
 
-GameResult Game::getResult() const {
+template<Side S>
+void Game::doMove(Move move) {
+    applyMove<S>(move, undoStack[undoTop++]);
+}
+
+template<Side S>
+void Game::undoMove() {
+    revertMove<S>(undoStack[--undoTop]);
+}
+
+void Game::doMove(Move move) {
+    applyMove(move, undoStack[undoTop++]);
+}
+
+void Game::undoMove() {
+    revertMove(undoStack[--undoTop]);
+}
+
+// The search uses both sides' specializations
+template void Game::generateLegalMoves<WHITE>(MoveList&) const;
+template void Game::generateLegalMoves<BLACK>(MoveList&) const;
+template void Game::generateCaptures<WHITE>(MoveList&) const;
+template void Game::generateCaptures<BLACK>(MoveList&) const;
+template void Game::generateQuiets<WHITE>(MoveList&) const;
+template void Game::generateQuiets<BLACK>(MoveList&) const;
+template bool Game::isLegalMove<WHITE>(Move) const;
+template bool Game::isLegalMove<BLACK>(Move) const;
+template void Game::doMove<WHITE>(Move);
+template void Game::doMove<BLACK>(Move);
+template void Game::undoMove<WHITE>();
+template void Game::undoMove<BLACK>();
+
+void Game::doNullMove() {
+    UndoInfo& undo = undoStack[undoTop++];
+    undo.move = Move();
+    undo.capturedPiece = 0;
+    undo.hash = hash;
+    undo.pawnKey = pawnKey;
+    undo.evalState = evalState;
+    undo.result = result;
+
+    hash ^= ZOBRIST.side;
+    sideToMove = (sideToMove == WHITE) ? BLACK : WHITE;
+    ply++;
+    result = computeResult();
+}
+
+int Game::repetitionDistance() const {
+    // Pawn moves and captures change the pawn key for good, so only the
+    // tail of the stack with the current pawns can hold this position
+    for (int i = undoTop - 1; i >= 0 && undoStack[i].pawnKey == pawnKey; i--) {
+        if (undoStack[i].hash == hash) return undoTop - i;
+    }
+    return 0;
+}
+
+bool Game::hasAnyLegalMove() const {
+    // A queen always has a move: each neighbouring square is either empty
+    // or holds a pawn to take
+    if (sideToMove == BLACK) return queen != 0;
+
+    // Pawns need a free square ahead or the queen on a diagonal. Double
+    // pushes need the single push square free, so they add nothing.
+    Bitboard empty = ~(pawns | queen);
+    Bitboard captures = (((pawns & ~FILE_A) << 7) | ((pawns & ~FILE_H) << 9)) & queen;
+    return ((pawns << 8) & empty) || captures;
+}
+
+GameResult Game::computeResult() const {
     // Check if any pawn reached rank 8 (promotion)
     if (pawns & RANK_8) {
         return GameResult::WHITE_WINS_PROMOTION;
@@ -393,18 +655,13 @@ GameResult Game::getResult() const {
     }
 
     // Check for stalemate
-    auto moves = generateLegalMoves();
-    if (moves.empty()) {
+    if (!hasAnyLegalMove()) {
         return GameResult::DRAW_STALEMATE;
     }
 
     return GameResult::ONGOING;
 }
 
-bool Game::isGameOver() const {
-    return getResult() != GameResult::ONGOING;
-}
-
 int Game::getQueenSquare() const {
     if (queen == 0) return NO_SQUARE;
     return lsb(queen);
@@ -497,4 +754,133 @@ std::string Game::toFen() const {
     return fen;
 }
 
+bool Game::setFromFen(const std::string& fen) {
+    Bitboard p = 0;
+    Bitboard q = 0;
+    int rank = 7;
+    int file = 0;
+    size_t i = 0;
+
+    // Board representation (rank 8 to rank 1)
+    for (; i < fen.size() && fen[i] != ' '; i++) {
+        char c = fen[i];
+        if (c == '/') {
+            if (file != 8 || rank == 0) return false;
+            rank--;
+            file = 0;
+        } else if (c >= '1' && c <= '8') {
+            file += c - '0';
+            if (file > 8) return false;
+        } else if (c == 'P' || c == 'q') {
+            if (file > 7) return false;
+            Bitboard bb = squareBB(makeSquare(file, rank));
+            if (c == 'P') p |= bb; else q |= bb;
+            file++;
+        } else {
+            return false;
+        }
+    }
+    if (rank != 0 || file != 8 || popCount(q) > 1) return false;
+    // At most the eight starting pawns, none behind the start rank
+    if (popCount(p) > 8 || (p & RANK_1) || (p & q)) return false;
+
+    // Side to move
+    if (i + 1 >= fen.size() || (fen[i + 1] != 'w' && fen[i + 1] != 'b')) return false;
+    Side side = fen[i + 1] == 'w' ? WHITE : BLACK;
+
+    setPosition(p, q, side);
+
+    // Fullmove number is the last field, if present
+    size_t last = fen.find_last_of(' ');
+    if (last > i + 1) {
+        int fullmove = std::atoi(fen.c_str() + last + 1);
+        if (fullmove > 0) ply = (fullmove - 1) * 2 + (side == BLACK ? 1 : 0);
+    }
+    return true;
+}
+
+namespace {
+
+// Pawns can only stand on a2-h7
+constexpr int INDEX_PAWN_SQUARES = 48;
+constexpr Bitboard INDEX_PAWN_AREA = ~(RANK_1 | RANK_8);
+
+struct IndexTables {
+    uint64_t binomial[INDEX_PAWN_SQUARES + 1][INDEX_MAX_PAWNS + 1] = {};  // C(n, k)
+    uint64_t base[INDEX_MAX_PAWNS + 2] = {};  // First index with k pawns
+};
+
+constexpr IndexTables makeIndexTables() {
+    IndexTables t;
+    for (int n = 0; n <= INDEX_PAWN_SQUARES; n++) {
+        t.binomial[n][0] = 1;
+        for (int k = 1; k <= INDEX_MAX_PAWNS && k <= n; k++) {
+            t.binomial[n][k] = t.binomial[n - 1][k - 1] + (k < n ? t.binomial[n - 1][k] : 0);
+        }
+    }
+    // k pawns leave 64 - k squares for the queen, times two sides
+    for (int k = 0; k <= INDEX_MAX_PAWNS; k++) {
+        t.base[k + 1] = t.base[k] + t.binomial[INDEX_PAWN_SQUARES][k] * (64 - k) * 2;
+    }
+    return t;
+}
+
+constexpr IndexTables indexTables = makeIndexTables();
+
+} // namespace
+
+uint64_t Game::indexBase(int pawnCount) {
+    return indexTables.base[pawnCount];
+}
+
+uint64_t Game::indexCount(int pawnCount) {
+    return indexTables.base[pawnCount + 1] - indexTables.base[pawnCount];
+}
+
+uint64_t Game::indexOf() const {
+    int k = popCount(pawns);
+    if (popCount(queen) != 1 || (queen & pawns) || (pawns & ~INDEX_PAWN_AREA) ||
+        k > INDEX_MAX_PAWNS) {
+        return NO_POSITION_INDEX;
+    }
+
+    uint64_t rank = 0;
+    int i = 1;
+    for (Bitboard bb = pawns; bb; bb &= bb - 1) {
+        rank += indexTables.binomial[lsb(bb) - 8][i++];
+    }
+
+    int q = lsb(queen);
+    int queenRank = q - popCount(pawns & (queen - 1));
+    return indexTables.base[k] + (rank * (64 - k) + queenRank) * 2 + sideToMove;
+}
+
+bool Game::fromIndex(uint64_t index) {
+    int k = 0;
+    while (k <= INDEX_MAX_PAWNS && index >= indexTables.base[k + 1]) k++;
+    if (k > INDEX_MAX_PAWNS) return false;
+
+    uint64_t local = index - indexTables.base[k];
+    Side side = static_cast<Side>(local & 1);
+    local >>= 1;
+    int queenRank = static_cast<int>(local % (64 - k));
+    uint64_t rank = local / (64 - k);
+
+    // Colex unranking: the highest square first, each the largest c with
+    // C(c, i) <= what is left of the rank
+    Bitboard p = 0;
+    int c = INDEX_PAWN_SQUARES - 1;
+    for (int i = k; i >= 1; i--, c--) {
+        while (indexTables.binomial[c][i] > rank) c--;
+        rank -= indexTables.binomial[c][i];
+        p |= squareBB(c + 8);
+    }
+
+    Bitboard empty = ~p;
+    for (int r = 0; r < queenRank; r++) empty &= empty - 1;
+
+    setPosition(p, empty & (0 - empty), side);
+    return true;
+}
+
 } // namespace PigsAndFarmers
@@ -1,10 +1,16 @@
 #ifndef GAME_H
 #define GAME_H
 
+#include <cassert>
 #include <cstdint>
 #include <vector>
 #include <string>
 #include <array>
+#include "eval.h"
+
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
 
 namespace PigsAndFarmers {
 
@@ -43,6 +49,91 @@ struct Move {
     bool operator!=(const Move& other) const { return data != other.data; }
 };
 
+// Upper bound on legal moves in any position: the queen has at most 27,
+// the pawns at most 18 (a push and a double push each, and only two can
+// capture the queen). Holds only for at most eight pawns, none on rank 1,
+// which setFromFen() and analyzeBatch() enforce.
+constexpr int MAX_MOVES = 32;
+
+// Maximum search depth in plies (sizes the undo stack and per-ply tables)
+constexpr int MAX_PLY = 128;
+
+// Fixed-capacity list, lives on the stack (or inline in its owner) so the
+// search never touches the heap. Pushing more than N items is a bug.
+template<typename T, size_t N>
+struct FixedList {
+    std::array<T, N> items;
+    int count = 0;
+
+    void push(const T& item) {
+        assert(count < static_cast<int>(N));
+        items[count++] = item;
+    }
+    void clear() { count = 0; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    T& operator[](size_t i) { return items[i]; }
+    const T& operator[](size_t i) const { return items[i]; }
+
+    T* begin() { return items.data(); }
+    T* end() { return items.data() + count; }
+    const T* begin() const { return items.data(); }
+    const T* end() const { return items.data() + count; }
+};
+
+// Move generator output
+using MoveList = FixedList<Move, MAX_MOVES>;
+
+// Unsigned values of a fixed width (1-32 bits) packed into 64-bit words,
+// a value straddling two words where the width doesn't divide 64
+class PackedArray {
+public:
+    PackedArray() = default;
+    PackedArray(size_t size, int bits) { resize(size, bits); }
+
+    // Zero-fills
+    void resize(size_t size, int bitsPerValue) {
+        count = size;
+        bits = bitsPerValue;
+        mask = (uint64_t(1) << bits) - 1;
+        words.assign((size * bits + 63) / 64, 0);
+    }
+
+    size_t size() const { return count; }
+    int bitsPerValue() const { return bits; }
+
+    uint32_t get(size_t i) const {
+        size_t bit = i * bits;
+        size_t w = bit >> 6;
+        int shift = static_cast<int>(bit & 63);
+        uint64_t value = words[w] >> shift;
+        if (shift + bits > 64) value |= words[w + 1] << (64 - shift);
+        return static_cast<uint32_t>(value & mask);
+    }
+
+    void set(size_t i, uint32_t value) {
+        size_t bit = i * bits;
+        size_t w = bit >> 6;
+        int shift = static_cast<int>(bit & 63);
+        words[w] = (words[w] & ~(mask << shift)) | (uint64_t(value) << shift);
+        if (shift + bits > 64) {
+            int low = 64 - shift;  // Bits that went into words[w]
+            words[w + 1] = (words[w + 1] & ~(mask >> low)) | (uint64_t(value) >> low);
+        }
+    }
+
+    // Backing store, for serializing
+    std::vector<uint64_t>& data() { return words; }
+    const std::vector<uint64_t>& data() const { return words; }
+
+private:
+    std::vector<uint64_t> words;
+    size_t count = 0;
+    int bits = 1;
+    uint64_t mask = 1;
+};
+
 // Move flags
 enum MoveFlag {
     QUIET = 0,
@@ -51,7 +142,7 @@ enum MoveFlag {
 };
 
 // Game result
-enum class GameResult {
+enum class GameResult : uint8_t {
     ONGOING,
     WHITE_WINS_PROMOTION,  // Pawn reached rank 8
     WHITE_WINS_CAPTURE,    // Queen captured
@@ -65,6 +156,17 @@ enum Side {
     BLACK = 1   // Farmer (Queen)
 };
 
+// The other side
+constexpr Side operator~(Side side) { return static_cast<Side>(side ^ 1); }
+
+// Dense position index (Game::indexOf). Every position with the queen on
+// the board and at most 8 pawns, all on a2-h7, gets a distinct number below
+// Game::indexBase(INDEX_MAX_PAWNS + 1), with no gaps. Positions are grouped by pawn count;
+// within a group the index is (colex rank of the pawn set among the 48
+// squares, queen square counted among the empty ones, side to move).
+constexpr int INDEX_MAX_PAWNS = 8;
+constexpr uint64_t NO_POSITION_INDEX = ~uint64_t(0);
+
 class Game {
 public:
     Game();
@@ -74,16 +176,50 @@ public:
     void setPosition(Bitboard pawns, Bitboard queen, Side side);
 
     // Move generation
-    std::vector<Move> generateLegalMoves() const;
+    MoveList generateLegalMoves() const;
+    void generateLegalMoves(MoveList& moves) const;
+    void generateCaptures(MoveList& moves) const;  // Captures and promotions
+    void generateQuiets(MoveList& moves) const;    // Everything else
     bool isLegalMove(Move move) const;
 
     // Move execution
     bool makeMove(Move move);
     bool unmakeMove();
 
-    // Game state queries
-    GameResult getResult() const;
-    bool isGameOver() const;
+    // Trusted fast path for the search: the move must come from this
+    // position's move generator. Skips validation and moveHistory, keeping
+    // undo info on a fixed stack indexed by search ply.
+    void doMove(Move move);
+    void undoMove();
+
+    // Side-specialized versions of the above for code that knows the side
+    // to move at compile time (the search). S must be getSideToMove(); for
+    // undoMove it is the side that made the move.
+    template<Side S> void generateLegalMoves(MoveList& moves) const;
+    template<Side S> void generateCaptures(MoveList& moves) const;
+    template<Side S> void generateQuiets(MoveList& moves) const;
+    template<Side S> bool isLegalMove(Move move) const;
+    template<Side S> void doMove(Move move);
+    template<Side S> void undoMove();
+
+    // Pass the turn (null-move pruning). Undone with undoMove() like any
+    // other move, and recorded as an invalid Move on the undo stack.
+    void doNullMove();
+    bool lastMoveWasNull() const { return undoTop > 0 && !undoStack[undoTop - 1].move.isValid(); }
+
+    // Plies back to an earlier occurrence of this position on the undo
+    // stack, 0 if there is none. Pawn moves can't be undone, so positions
+    // only repeat through null moves.
+    int repetitionDistance() const;
+
+    // Game state queries. The result is kept up to date as moves are made,
+    // so these are a member load.
+    GameResult getResult() const { return result; }
+    bool isGameOver() const { return result != GameResult::ONGOING; }
+
+    // Whether the side to move has a move, from bitboards alone (no move
+    // generation)
+    bool hasAnyLegalMove() const;
     Side getSideToMove() const { return sideToMove; }
 
     // Board queries
@@ -96,17 +232,34 @@ public:
 
     // Zobrist hashing
     uint64_t getHash() const { return hash; }
+    uint64_t getPawnKey() const { return pawnKey; }  // Pawn squares only
+
+    // Incrementally updated evaluation terms
+    const EvalState& getEvalState() const { return evalState; }
 
     // Utility
     std::string moveToAlgebraic(Move move) const;
     Move algebraicToMove(const std::string& str) const;
     std::string toFen() const;
+    bool setFromFen(const std::string& fen);  // False if malformed, over eight pawns or a pawn on rank 1
+
+    // Dense position index, NO_POSITION_INDEX for a position outside it (no
+    // queen, a pawn on rank 1 or 8, or more than INDEX_MAX_PAWNS pawns)
+    uint64_t indexOf() const;
+    bool fromIndex(uint64_t index);  // False if out of range
+    // Indices of the positions with pawnCount pawns start at indexBase()
+    // and number indexCount()
+    static uint64_t indexBase(int pawnCount);
+    static uint64_t indexCount(int pawnCount);
 
     // Move history for undo
     struct UndoInfo {
         Move move;
         Bitboard capturedPiece;  // For queen capturing pawn
         uint64_t hash;
+        uint64_t pawnKey;
+        EvalState evalState;
+        GameResult result;
     };
 
     const std::vector<UndoInfo>& getMoveHistory() const { return moveHistory; }
@@ -119,37 +272,96 @@ public:
     static Bitboard bishopAttacks(int sq, Bitboard occupied);
     static Bitboard queenAttacks(int sq, Bitboard occupied);
 
+    // Loop-based ray walks, kept as the reference implementation for
+    // building the magic tables and cross-checking perft
+    static Bitboard rookAttacksSlow(int sq, Bitboard occupied);
+    static Bitboard bishopAttacksSlow(int sq, Bitboard occupied);
+
 private:
     Bitboard pawns;     // White pawns bitboard
     Bitboard queen;     // Black queen bitboard
     Side sideToMove;
     uint64_t hash;
+    uint64_t pawnKey;
     int ply;
+    EvalState evalState;
+    GameResult result;
 
     std::vector<UndoInfo> moveHistory;
+    std::array<UndoInfo, MAX_PLY> undoStack;
+    int undoTop;
+
+    void applyMove(Move move, UndoInfo& undo);
+    void revertMove(const UndoInfo& undo);
+    template<Side S> void applyMove(Move move, UndoInfo& undo);
+    template<Side S> void revertMove(const UndoInfo& undo);
+    void computeEvalState();
+    GameResult computeResult() const;
 
     // Move generation helpers
-    void generatePawnMoves(std::vector<Move>& moves) const;
-    void generateQueenMoves(std::vector<Move>& moves) const;
-
-    // Zobrist keys
-    static std::array<uint64_t, 64> pawnKeys;
-    static std::array<uint64_t, 64> queenKeys;
-    static uint64_t sideKey;
-    static bool zobristInitialized;
-    static void initZobrist();
+    enum GenType { GEN_ALL, GEN_CAPTURES, GEN_QUIETS };
+    void generateMoves(MoveList& moves, GenType type) const;
+    template<Side S> void generateMoves(MoveList& moves, GenType type) const;
+    void generatePawnMoves(MoveList& moves, GenType type) const;
+    void generateQueenMoves(MoveList& moves, GenType type) const;
+
+};
+
+// Fancy magic entry for one square. With USE_PEXT (native x86 builds
+// with BMI2) the index is taken with PEXT and the multiplier is unused.
+struct Magic {
+    Bitboard mask;       // Relevant occupancy (ray squares minus edges)
+    Bitboard magic;
+    Bitboard* attacks;   // Slice of the shared attack table
+    unsigned shift;
+
+    unsigned index(Bitboard occupied) const {
+#ifdef USE_PEXT
+        return static_cast<unsigned>(_pext_u64(occupied, mask));
+#else
+        return static_cast<unsigned>(((occupied & mask) * magic) >> shift);
+#endif
+    }
 };
 
-// Precomputed attack tables
-extern std::array<Bitboard, 64> kingAttacks;
-extern std::array<Bitboard, 64> knightAttacks;
+// Precomputed attack tables, built at compile time. The magics point into
+// slider attack slices that initAttackTables() fills on first use (the
+// Game constructor calls it; safe from several threads).
+extern const std::array<Bitboard, 64> kingAttacks;
+extern const std::array<Bitboard, 64> knightAttacks;
+extern const std::array<Magic, 64> rookMagics;
+extern const std::array<Magic, 64> bishopMagics;
 extern void initAttackTables();
 
+// Sliding attacks. Defining USE_REFERENCE_ATTACKS routes them through the
+// loop versions so perft can be compared between the two.
+inline Bitboard Game::rookAttacks(int sq, Bitboard occupied) {
+#ifdef USE_REFERENCE_ATTACKS
+    return rookAttacksSlow(sq, occupied);
+#else
+    const Magic& m = rookMagics[sq];
+    return m.attacks[m.index(occupied)];
+#endif
+}
+
+inline Bitboard Game::bishopAttacks(int sq, Bitboard occupied) {
+#ifdef USE_REFERENCE_ATTACKS
+    return bishopAttacksSlow(sq, occupied);
+#else
+    const Magic& m = bishopMagics[sq];
+    return m.attacks[m.index(occupied)];
+#endif
+}
+
+inline Bitboard Game::queenAttacks(int sq, Bitboard occupied) {
+    return rookAttacks(sq, occupied) | bishopAttacks(sq, occupied);
+}
+
 // Square/file/rank utilities
-inline int fileOf(int sq) { return sq & 7; }
-inline int rankOf(int sq) { return sq >> 3; }
-inline int makeSquare(int file, int rank) { return rank * 8 + file; }
-inline Bitboard squareBB(int sq) { return 1ULL << sq; }
+constexpr int fileOf(int sq) { return sq & 7; }
+constexpr int rankOf(int sq) { return sq >> 3; }
+constexpr int makeSquare(int file, int rank) { return rank * 8 + file; }
+constexpr Bitboard squareBB(int sq) { return 1ULL << sq; }
 
 // Rank masks
 constexpr Bitboard RANK_1 = 0x00000000000000FFULL;
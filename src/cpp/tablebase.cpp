@@ -0,0 +1,246 @@
+#include "tablebase.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fstream>
+
+namespace PigsAndFarmers {
+
+namespace {
+
+constexpr char TB_MAGIC[4] = { 'P', 'F', 'T', 'B' };
+constexpr uint8_t TB_VERSION = 2;
+constexpr size_t TB_HEADER_SIZE = 8;
+
+// Pawns can only stand on a2-h7
+constexpr int PAWN_SQUARES = 48;
+
+constexpr uint8_t TB_DRAW = 0;
+constexpr uint8_t TB_LOSS = 0x80;
+constexpr int TB_MAX_DTM = 127;
+
+uint8_t win(int dtm) { return static_cast<uint8_t>(dtm); }
+uint8_t loss(int dtm) { return static_cast<uint8_t>(TB_LOSS | dtm); }
+bool isWin(uint8_t v) { return v != TB_DRAW && !(v & TB_LOSS); }
+bool isLoss(uint8_t v) { return (v & TB_LOSS) != 0; }
+int dtmOf(uint8_t v) { return v & ~TB_LOSS; }
+
+// Packed code of a value: 0 = draw, 2n - 1 = win in n, 2n = loss in n
+uint32_t encodeValue(uint8_t v) {
+    if (v == TB_DRAW) return 0;
+    return isLoss(v) ? 2 * dtmOf(v) : 2 * dtmOf(v) - 1;
+}
+
+uint8_t decodeValue(uint32_t code) {
+    if (code == 0) return TB_DRAW;
+    return code & 1 ? win((code + 1) / 2) : loss(code / 2);
+}
+
+int bitsFor(uint32_t maxCode) {
+    int bits = 1;
+    while ((maxCode >> bits) != 0) bits++;
+    return bits;
+}
+
+// Offset of a position in its pawn count's table
+size_t localIndex(const Game& game) {
+    return game.indexOf() - Game::indexBase(game.getPawnCount());
+}
+
+// Value of the position from its successors, which values[] already holds.
+// False if its distance to mate doesn't fit the value byte.
+bool solve(Game& game, const std::vector<std::vector<uint8_t>>& values, uint8_t& value) {
+    MoveList moves = game.generateLegalMoves();
+
+    bool canDraw = false;
+    int bestWin = INT_MAX;  // Shortest win found
+    int longestLoss = 0;    // Longest resistance if every move loses
+
+    for (const Move& m : moves) {
+        game.doMove(m);
+        GameResult result = game.getResult();
+
+        if (result == GameResult::ONGOING) {
+            uint8_t v = values[game.getPawnCount()][localIndex(game)];
+
+            if (isLoss(v)) {
+                bestWin = std::min(bestWin, dtmOf(v) + 1);
+            } else if (isWin(v)) {
+                longestLoss = std::max(longestLoss, dtmOf(v) + 1);
+            } else {
+                canDraw = true;
+            }
+        } else if (result == GameResult::DRAW_STALEMATE) {
+            canDraw = true;
+        } else {
+            bestWin = 1;  // The move itself ends the game in our favour
+        }
+
+        game.undoMove();
+    }
+
+    if (bestWin != INT_MAX) {
+        if (bestWin > TB_MAX_DTM) return false;
+        value = win(bestWin);
+    } else if (canDraw || moves.empty()) {
+        value = TB_DRAW;
+    } else {
+        if (longestLoss > TB_MAX_DTM) return false;
+        value = loss(longestLoss);
+    }
+    return true;
+}
+
+// All k-pawn sets, most advanced (highest rank sum) first
+std::vector<Bitboard> pawnSetsByAdvancement(int k) {
+    std::vector<std::pair<int, Bitboard>> sets;
+
+    Bitboard set = (1ULL << k) - 1;  // Gosper's hack over 48 bits
+    Bitboard limit = 1ULL << PAWN_SQUARES;
+    while (set < limit) {
+        Bitboard pawns = set << 8;
+        int rankSum = 0;
+        for (Bitboard bb = pawns; bb; bb &= bb - 1) {
+            rankSum += rankOf(Game::lsb(bb));
+        }
+        sets.push_back({rankSum, pawns});
+
+        Bitboard c = set & (0 - set);
+        Bitboard r = set + c;
+        set = (((r ^ set) >> 2) / c) | r;
+    }
+
+    std::stable_sort(sets.begin(), sets.end(),
+                     [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    std::vector<Bitboard> result;
+    result.reserve(sets.size());
+    for (const auto& s : sets) result.push_back(s.second);
+    return result;
+}
+
+} // namespace
+
+size_t Tablebase::tableSize(int pawnCount) {
+    return static_cast<size_t>(Game::indexCount(pawnCount));
+}
+
+bool Tablebase::generate(int maxPawns) {
+    maxPawns = std::max(1, std::min(maxPawns, MAX_PAWNS));
+
+    // Solved into bytes, packed once the widest value is known
+    std::vector<std::vector<uint8_t>> values(1);
+    uint32_t maxCode = 0;
+    Game game;
+
+    for (int k = 1; k <= maxPawns; k++) {
+        values.push_back(std::vector<uint8_t>(tableSize(k), TB_DRAW));
+        std::vector<uint8_t>& table = values[k];
+
+        for (Bitboard pawns : pawnSetsByAdvancement(k)) {
+            // White to move depends only on more advanced pawn sets, black
+            // to move on this set with white to move (or one pawn fewer)
+            for (Side side : { WHITE, BLACK }) {
+                for (int q = 0; q < 64; q++) {
+                    if (pawns & squareBB(q)) continue;
+
+                    game.setPosition(pawns, squareBB(q), side);
+                    uint8_t v;
+                    if (!solve(game, values, v)) return false;
+                    table[localIndex(game)] = v;
+                    maxCode = std::max(maxCode, encodeValue(v));
+                }
+            }
+        }
+    }
+
+    valueBits = bitsFor(maxCode);
+    tables.assign(1, {});
+    for (int k = 1; k <= maxPawns; k++) {
+        PackedArray packed(tableSize(k), valueBits);
+        for (size_t i = 0; i < values[k].size(); i++) packed.set(i, encodeValue(values[k][i]));
+        tables.push_back(std::move(packed));
+    }
+    return true;
+}
+
+std::vector<uint8_t> Tablebase::serialize() const {
+    std::vector<uint8_t> data(TB_HEADER_SIZE, 0);
+    std::memcpy(data.data(), TB_MAGIC, 4);
+    data[4] = TB_VERSION;
+    data[5] = static_cast<uint8_t>(getMaxPawns());
+    data[6] = static_cast<uint8_t>(valueBits);
+
+    for (size_t k = 1; k < tables.size(); k++) {
+        for (uint64_t word : tables[k].data()) {
+            for (int i = 0; i < 8; i++) data.push_back(static_cast<uint8_t>(word >> (8 * i)));
+        }
+    }
+    return data;
+}
+
+bool Tablebase::load(const uint8_t* data, size_t size) {
+    if (size < TB_HEADER_SIZE || std::memcmp(data, TB_MAGIC, 4) != 0 ||
+        data[4] != TB_VERSION) {
+        return false;
+    }
+
+    int maxPawns = data[5];
+    int bits = data[6];
+    if (maxPawns < 1 || maxPawns > MAX_PAWNS || bits < 1 || bits > 8) return false;
+
+    std::vector<PackedArray> loaded(1);
+    size_t expected = TB_HEADER_SIZE;
+    for (int k = 1; k <= maxPawns; k++) {
+        loaded.emplace_back(tableSize(k), bits);
+        expected += loaded[k].data().size() * 8;
+    }
+    if (size != expected) return false;
+
+    const uint8_t* p = data + TB_HEADER_SIZE;
+    for (int k = 1; k <= maxPawns; k++) {
+        for (uint64_t& word : loaded[k].data()) {
+            word = 0;
+            for (int i = 0; i < 8; i++) word |= static_cast<uint64_t>(*p++) << (8 * i);
+        }
+    }
+    tables = std::move(loaded);
+    valueBits = bits;
+    return true;
+}
+
+bool Tablebase::loadFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                              std::istreambuf_iterator<char>());
+    return load(data.data(), data.size());
+}
+
+bool Tablebase::saveFile(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+
+    std::vector<uint8_t> data = serialize();
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return static_cast<bool>(out);
+}
+
+bool Tablebase::covers(const Game& game) const {
+    int pawnCount = game.getPawnCount();
+    return pawnCount >= 1 && pawnCount <= getMaxPawns() &&
+           game.indexOf() != NO_POSITION_INDEX;
+}
+
+bool Tablebase::probe(const Game& game, Result& result) const {
+    if (!covers(game)) return false;
+
+    uint8_t v = decodeValue(tables[game.getPawnCount()].get(localIndex(game)));
+
+    result.wdl = isWin(v) ? 1 : isLoss(v) ? -1 : 0;
+    result.dtm = dtmOf(v);
+    return true;
+}
+
+} // namespace PigsAndFarmers
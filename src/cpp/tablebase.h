@@ -0,0 +1,59 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include "game.h"
+#include <vector>
+#include <string>
+
+namespace PigsAndFarmers {
+
+// Exact results for positions with few pawns, built by retrograde analysis.
+//
+// Positions are stored by Game::indexOf(), each pawn count in its own
+// table. Every white move advances a pawn,
+// so the positions form a DAG: solving pawn sets from most to least
+// advanced, white-to-move before black-to-move, lets each position be
+// computed once from already-solved successors.
+//
+// Values are packed at the fewest bits that hold the longest distance:
+// 0 = draw, 2n - 1 = side to move wins in n plies, 2n = loses in n plies.
+//
+// File format (little endian):
+//   char[4] "PFTB", uint8 version, uint8 maxPawns, uint8 bits per value,
+//   uint8 reserved, then for k = 1..maxPawns the PackedArray words (uint64)
+//   of Game::indexCount(k) values.
+class Tablebase {
+public:
+    static constexpr int MAX_PAWNS = 4;  // 4 pawns is already 25MB
+
+    struct Result {
+        int wdl;   // 1 = side to move wins, 0 = draw, -1 = loses
+        int dtm;   // Plies to the end of the game with best play
+    };
+
+    // Solve all positions with up to maxPawns pawns. Fails only if a
+    // distance doesn't fit the value byte.
+    bool generate(int maxPawns);
+
+    bool load(const uint8_t* data, size_t size);
+    bool loadFile(const std::string& path);
+    bool saveFile(const std::string& path) const;
+    std::vector<uint8_t> serialize() const;
+
+    int getMaxPawns() const { return static_cast<int>(tables.size()) - 1; }
+    bool covers(const Game& game) const;
+    bool probe(const Game& game, Result& result) const;
+
+    int getValueBits() const { return valueBits; }
+
+    static size_t tableSize(int pawnCount);
+
+private:
+    // tables[k] holds the positions with k pawns (tables[0] unused)
+    std::vector<PackedArray> tables;
+    int valueBits = 8;
+};
+
+} // namespace PigsAndFarmers
+
+#endif // TABLEBASE_H
@@ -0,0 +1,269 @@
+// Native perft and search benchmark
+//
+// Usage: bench [--perft N] [--search N] [--nodes N] [--threads N] [--hash MB] [--divide]
+//   Runs perft to depth N (default 6) and a fixed-depth search to depth N
+//   (default 12) from each position of a fixed set, printing one JSON object
+//   per line so results can be diffed and tracked from commit to commit.
+//   --nodes also stops each search after about N nodes, which is
+//   reproducible with one thread where a time limit isn't.
+//   --divide also prints the node count below each root move.
+//   The first line after the config times engine startup as the worker's
+//   init() does it: the first Game (attack tables), an AI (TT allocation),
+//   clearHash() and a first depth-1 move, so it measures a fresh process.
+//
+// Build with -DUSE_REFERENCE_ATTACKS (make bench-reference) to check the
+// magic attack tables against the loop versions: perft must not change.
+// Build with -DSEARCH_STATS (make bench-stats) to also print the search
+// profiling counters after each search.
+
+#include "../game.h"
+#include "../ai.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace PigsAndFarmers;
+
+namespace {
+
+// Start position plus undecided positions reached by random play, covering
+// both sides to move, the queen behind and in front of the pawns, and
+// pawns close to promotion
+const char* const POSITIONS[] = {
+    "3q4/8/8/8/8/8/PPPPPPPP/8 w - - 0 1",
+    "8/8/8/8/4P3/7P/PPP2PP1/2q5 w - - 0 3",
+    "8/8/3q4/P7/2P3P1/8/1P1PPP1P/8 b - - 0 4",
+    "8/4q3/8/8/P2P4/1PP1P3/5PPP/8 w - - 0 6",
+    "8/8/8/8/q2PP1PP/1P3P2/P1P5/8 b - - 0 7",
+    "5q2/8/1P6/8/P6P/3PP3/2P2P2/8 w - - 0 9",
+    "8/4q3/8/3P4/2P1PP2/P7/7P/8 w - - 0 12",
+    "8/8/1P1q4/3P4/4PP2/6P1/2P5/8 w - - 0 14",
+};
+
+using Clock = std::chrono::steady_clock;
+
+long long elapsedUs(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
+unsigned long long perSecond(uint64_t count, long long us) {
+    return static_cast<unsigned long long>(count * 1e6 / (us > 0 ? us : 1));
+}
+
+void printStats(const char* fen, const SearchStats& s, int depth) {
+    std::string cutoffs;
+    for (uint64_t c : s.cutoffsAt) {
+        if (!cutoffs.empty()) cutoffs += ',';
+        cutoffs += std::to_string(c);
+    }
+    std::string ebf;
+    for (int d = 2; d <= depth; d++) {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "%.2f", s.branchingFactor(d));
+        if (!ebf.empty()) ebf += ',';
+        ebf += buf;
+    }
+
+    std::printf("{\"type\":\"stats\",\"fen\":\"%s\",\"mainNodes\":%llu,\"qsNodes\":%llu,"
+                "\"betaCutoffs\":%llu,\"firstMoveCutoffRate\":%.4f,\"cutoffsAt\":[%s],"
+                "\"ttProbes\":%llu,\"ttHits\":%llu,\"ttCollisions\":%llu,\"ttStores\":%llu,"
+                "\"ttOverwrites\":%llu,\"branchingFactor\":[%s],"
+                "\"movegenMs\":%llu,\"evalMs\":%llu,\"orderingMs\":%llu}\n",
+                fen, static_cast<unsigned long long>(s.mainNodes),
+                static_cast<unsigned long long>(s.qsNodes),
+                static_cast<unsigned long long>(s.betaCutoffs), s.firstMoveCutoffRate(),
+                cutoffs.c_str(), static_cast<unsigned long long>(s.ttProbes),
+                static_cast<unsigned long long>(s.ttHits),
+                static_cast<unsigned long long>(s.ttCollisions),
+                static_cast<unsigned long long>(s.ttStores),
+                static_cast<unsigned long long>(s.ttOverwrites), ebf.c_str(),
+                static_cast<unsigned long long>(s.movegenNs / 1000000),
+                static_cast<unsigned long long>(s.evalNs / 1000000),
+                static_cast<unsigned long long>(s.orderingNs / 1000000));
+}
+
+uint64_t perft(Game& game, int depth) {
+    if (depth == 0) return 1;
+    if (game.getResult() != GameResult::ONGOING) return 0;
+
+    MoveList moves;
+    game.generateLegalMoves(moves);
+    if (depth == 1) return moves.size();
+
+    uint64_t nodes = 0;
+    for (Move move : moves) {
+        game.doMove(move);
+        nodes += perft(game, depth - 1);
+        game.undoMove();
+    }
+    return nodes;
+}
+
+struct Options {
+    int perftDepth = 6;
+    int searchDepth = 12;
+    long long nodeLimit = 0;
+    int threads = 1;
+    int hashMB = DEFAULT_HASH_MB;
+    bool divide = false;
+};
+
+bool parseArgs(int argc, char** argv, Options& opts) {
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--divide")) {
+            opts.divide = true;
+        } else if (!std::strcmp(argv[i], "--perft") && hasValue) {
+            opts.perftDepth = std::atoi(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--search") && hasValue) {
+            opts.searchDepth = std::atoi(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--nodes") && hasValue) {
+            opts.nodeLimit = std::atoll(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--threads") && hasValue) {
+            opts.threads = std::atoi(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--hash") && hasValue) {
+            opts.hashMB = std::atoi(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+    return opts.perftDepth >= 0 && opts.searchDepth >= 0 && opts.nodeLimit >= 0 &&
+           opts.threads >= 1 && opts.threads <= MAX_THREADS &&
+           opts.hashMB >= 1 && opts.hashMB <= MAX_HASH_MB;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parseArgs(argc, argv, opts)) {
+        std::fprintf(stderr, "usage: bench [--perft N] [--search N] [--nodes N] [--threads N] "
+                             "[--hash MB] [--divide]\n");
+        return 1;
+    }
+
+#ifdef USE_REFERENCE_ATTACKS
+    const char* attacks = "reference";
+#else
+    const char* attacks = "magic";
+#endif
+    std::printf("{\"type\":\"config\",\"attacks\":\"%s\",\"perftDepth\":%d,"
+                "\"searchDepth\":%d,\"nodeLimit\":%lld,\"threads\":%d,\"hashMB\":%d}\n",
+                attacks, opts.perftDepth, opts.searchDepth, opts.nodeLimit, opts.threads,
+                opts.hashMB);
+
+    // Startup, before anything else has built the tables
+    {
+        auto start = Clock::now();
+        Game game;
+        long long tablesUs = elapsedUs(start);
+
+        auto aiStart = Clock::now();
+        AI startupAI;
+        long long aiUs = elapsedUs(aiStart);
+
+        auto clearStart = Clock::now();
+        startupAI.clearHash();
+        long long clearUs = elapsedUs(clearStart);
+
+        startupAI.setMultiPV(1);
+        startupAI.setMaxDepth(1);
+        startupAI.search(game);
+        long long firstMoveUs = elapsedUs(start);
+
+        std::printf("{\"type\":\"startup\",\"tablesUs\":%lld,\"aiUs\":%lld,"
+                    "\"clearHashUs\":%lld,\"firstMoveUs\":%lld}\n",
+                    tablesUs, aiUs, clearUs, firstMoveUs);
+    }
+
+    uint64_t perftNodes = 0;
+    long long perftUs = 0;
+    uint64_t searchNodes = 0;
+    long long searchUs = 0;
+
+    AI ai;
+    ai.setMultiPV(1);
+    ai.setThreads(opts.threads);
+    ai.setHashSizeMB(opts.hashMB);
+
+    for (const char* fen : POSITIONS) {
+        Game game;
+        if (!game.setFromFen(fen)) {
+            std::fprintf(stderr, "bad FEN: %s\n", fen);
+            return 1;
+        }
+
+        // Perft, optionally split by root move
+        if (opts.perftDepth > 0) {
+            auto start = Clock::now();
+            uint64_t nodes = 0;
+            MoveList moves;
+            game.generateLegalMoves(moves);
+            for (Move move : moves) {
+                game.doMove(move);
+                uint64_t count = perft(game, opts.perftDepth - 1);
+                game.undoMove();
+                nodes += count;
+                if (opts.divide) {
+                    std::printf("{\"type\":\"divide\",\"fen\":\"%s\",\"move\":\"%s\",\"nodes\":%llu}\n",
+                                fen, game.moveToAlgebraic(move).c_str(),
+                                static_cast<unsigned long long>(count));
+                }
+            }
+            long long us = elapsedUs(start);
+            perftNodes += nodes;
+            perftUs += us;
+            std::printf("{\"type\":\"perft\",\"fen\":\"%s\",\"depth\":%d,\"nodes\":%llu,"
+                        "\"timeMs\":%lld,\"nps\":%llu}\n",
+                        fen, opts.perftDepth, static_cast<unsigned long long>(nodes),
+                        us / 1000, perSecond(nodes, us));
+        }
+
+        // Fixed-depth search from a cold table, recording time to each depth
+        if (opts.searchDepth > 0) {
+            std::vector<SearchInfo> iterations;
+            ai.clearHash();
+            ai.clearKillers();
+            ai.setMaxDepth(opts.searchDepth);
+            ai.setTimeLimit(0);
+            ai.setNodeLimit(static_cast<uint64_t>(opts.nodeLimit));
+            ai.setCallback([&](const SearchInfo& info) { iterations.push_back(info); });
+
+            auto start = Clock::now();
+            SearchInfo info = ai.search(game);
+            long long us = elapsedUs(start);
+            uint64_t nodes = ai.getNodes();
+            uint64_t hits = ai.getTTHits();
+            searchNodes += nodes;
+            searchUs += us;
+
+            std::string best = info.pvLines.empty() || info.pvLines[0].moves.empty()
+                ? "none" : game.moveToAlgebraic(info.pvLines[0].moves[0]);
+            std::string depthTimes;
+            for (const SearchInfo& it : iterations) {
+                if (!depthTimes.empty()) depthTimes += ',';
+                depthTimes += std::to_string(it.timeMs);
+            }
+
+            std::printf("{\"type\":\"search\",\"fen\":\"%s\",\"depth\":%d,\"selDepth\":%d,"
+                        "\"score\":%d,\"best\":\"%s\",\"nodes\":%llu,\"timeMs\":%lld,"
+                        "\"nps\":%llu,\"ttHitRate\":%.4f,\"depthTimeMs\":[%s]}\n",
+                        fen, info.depth, info.selDepth, info.score, best.c_str(),
+                        static_cast<unsigned long long>(nodes), us / 1000, perSecond(nodes, us),
+                        nodes ? static_cast<double>(hits) / nodes : 0.0, depthTimes.c_str());
+
+            if (SearchStats::enabled) printStats(fen, ai.getSearchStats(), info.depth);
+        }
+        std::fflush(stdout);
+    }
+
+    std::printf("{\"type\":\"summary\",\"perftNodes\":%llu,\"perftNps\":%llu,"
+                "\"searchNodes\":%llu,\"searchNps\":%llu,\"timeMs\":%lld}\n",
+                static_cast<unsigned long long>(perftNodes), perSecond(perftNodes, perftUs),
+                static_cast<unsigned long long>(searchNodes), perSecond(searchNodes, searchUs),
+                (perftUs + searchUs) / 1000);
+    return 0;
+}
@@ -0,0 +1,75 @@
+// Native opening book generator
+//
+// Usage: bookgen [plies] [depth] [output]
+//   Searches every position reachable from the start in up to plies moves
+//   (default 2) to depth (default 14) and writes the best moves to output
+//   (default public/book.bin), which the engine worker fetches at startup.
+//   Transpositions are searched once.
+
+#include "../ai.h"
+#include "../book.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_set>
+
+using namespace PigsAndFarmers;
+
+int main(int argc, char** argv) {
+    int plies = argc > 1 ? std::atoi(argv[1]) : 2;
+    int depth = argc > 2 ? std::atoi(argv[2]) : 14;
+    std::string output = argc > 3 ? argv[3] : "public/book.bin";
+
+    if (plies < 0 || depth < 1 || depth >= MAX_PLY) {
+        std::fprintf(stderr, "usage: bookgen [plies] [depth] [output]\n");
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    AI ai;
+    ai.setMultiPV(1);
+    ai.setMaxDepth(depth);
+    ai.setTimeLimit(0);
+
+    OpeningBook book;
+    std::unordered_set<uint64_t> seen;
+    std::vector<Game> frontier(1);  // Game() is the start position
+    seen.insert(frontier[0].getHash());
+
+    for (int ply = 0; ply <= plies; ply++) {
+        std::vector<Game> next;
+        for (Game& game : frontier) {
+            if (game.getResult() != GameResult::ONGOING) continue;
+
+            SearchInfo info = ai.search(game);
+            if (!info.pvLines.empty()) {
+                // Book scores are from the side to move's point of view
+                int score = game.getSideToMove() == WHITE ? info.score : -info.score;
+                book.add(game.getHash(), ai.getBestMove(), score, info.depth);
+            }
+
+            if (ply == plies) continue;
+            for (Move move : game.generateLegalMoves()) {
+                Game child = game;
+                child.makeMove(move);
+                if (seen.insert(child.getHash()).second) next.push_back(child);
+            }
+        }
+        std::printf("ply %d: %zu positions, book has %zu\n", ply, frontier.size(), book.size());
+        std::fflush(stdout);
+        frontier = std::move(next);
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    if (!book.saveFile(output)) {
+        std::fprintf(stderr, "cannot write %s\n", output.c_str());
+        return 1;
+    }
+
+    std::printf("generated %zu book positions to depth %d in %lld ms -> %s\n",
+                book.size(), depth, static_cast<long long>(elapsed), output.c_str());
+    return 0;
+}
@@ -0,0 +1,229 @@
+// Native self-play driver, for generating positions and testing engine changes
+//
+// Usage: selfplay [games] [nodes] [threads] [output] [random plies] [seed]
+//   Plays games (default 100) from the start position with one
+//   single-threaded engine per worker thread (default: all cores), each move
+//   searched for about nodes (default 20000) nodes. The first random plies
+//   (default 4) are random legal moves, picked from seed (default 1) and the
+//   game number. Fixed node counts and a fresh TT per game make the output
+//   depend only on the arguments, whatever the thread count.
+//   Writes the games to output (default selfplay.bin).
+//
+//        selfplay --dump [file]
+//   Prints a record file, one game a line.
+//
+// Record format (little endian): char[4] "PFGR", uint8 version, uint8[3]
+// reserved, uint32 game count, then for each game: uint8 GameResult, uint8
+// random plies, uint16 ply count and per ply a uint16 Move and the int16
+// search score from White's point of view (0 for random plies), stored as
+// the TT stores scores (encodeStoredScore() in tt.h): mates as
+// +-(32767 - plies to mate), others clamped to +-31767.
+
+#include "../ai.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+
+using namespace PigsAndFarmers;
+
+namespace {
+
+constexpr char RECORD_MAGIC[4] = { 'P', 'F', 'G', 'R' };
+constexpr uint8_t RECORD_VERSION = 1;
+constexpr size_t RECORD_HEADER_SIZE = 12;
+
+struct GameRecord {
+    GameResult result = GameResult::ONGOING;
+    int randomPlies = 0;
+    std::vector<Move> moves;
+    std::vector<int16_t> scores;
+};
+
+void putLE(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+uint64_t getLE(const uint8_t* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) value |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return value;
+}
+
+GameRecord playGame(AI& ai, int randomPlies, uint32_t seed) {
+    GameRecord record;
+    Game game;
+    std::mt19937 rng(seed);
+
+    // Drop what the last game left in the TT and move ordering tables, so
+    // each game is reproducible
+    ai.clearHash();
+    ai.clearKillers();
+
+    while (!game.isGameOver()) {
+        Move move;
+        int16_t score = 0;
+        if (record.randomPlies < randomPlies) {
+            MoveList moves = game.generateLegalMoves();
+            move = moves[std::uniform_int_distribution<int>(0, moves.size() - 1)(rng)];
+            record.randomPlies++;
+        } else {
+            SearchInfo info = ai.search(game);
+            move = ai.getBestMove();
+            score = encodeStoredScore(info.score);
+        }
+        if (!move.isValid() || !game.makeMove(move)) break;
+        record.moves.push_back(move);
+        record.scores.push_back(score);
+    }
+
+    record.result = game.getResult();
+    return record;
+}
+
+bool writeRecords(const std::string& path, const std::vector<GameRecord>& games) {
+    std::vector<uint8_t> data(RECORD_HEADER_SIZE, 0);
+    std::memcpy(data.data(), RECORD_MAGIC, 4);
+    data[4] = RECORD_VERSION;
+    for (int i = 0; i < 4; i++) data[8 + i] = static_cast<uint8_t>(games.size() >> (8 * i));
+
+    for (const GameRecord& game : games) {
+        data.push_back(static_cast<uint8_t>(game.result));
+        data.push_back(static_cast<uint8_t>(game.randomPlies));
+        putLE(data, game.moves.size(), 2);
+        for (size_t i = 0; i < game.moves.size(); i++) {
+            putLE(data, game.moves[i].data, 2);
+            putLE(data, static_cast<uint16_t>(game.scores[i]), 2);
+        }
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return static_cast<bool>(out);
+}
+
+const char* resultName(GameResult result) {
+    switch (result) {
+        case GameResult::WHITE_WINS_PROMOTION: return "1-0 promotion";
+        case GameResult::WHITE_WINS_CAPTURE: return "1-0 capture";
+        case GameResult::BLACK_WINS: return "0-1";
+        case GameResult::DRAW_STALEMATE: return "1/2 stalemate";
+        default: return "*";
+    }
+}
+
+int dumpRecords(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                              std::istreambuf_iterator<char>());
+    if (data.size() < RECORD_HEADER_SIZE || std::memcmp(data.data(), RECORD_MAGIC, 4) != 0 ||
+        data[4] != RECORD_VERSION) {
+        std::fprintf(stderr, "not a game record file: %s\n", path.c_str());
+        return 1;
+    }
+
+    uint32_t count = static_cast<uint32_t>(getLE(data.data() + 8, 4));
+    size_t pos = RECORD_HEADER_SIZE;
+    for (uint32_t g = 0; g < count; g++) {
+        if (data.size() - pos < 4) {
+            std::fprintf(stderr, "truncated at game %u\n", g);
+            return 1;
+        }
+        GameResult result = static_cast<GameResult>(data[pos]);
+        int randomPlies = data[pos + 1];
+        size_t plies = getLE(&data[pos + 2], 2);
+        pos += 4;
+        if (data.size() - pos < plies * 4) {
+            std::fprintf(stderr, "truncated at game %u\n", g);
+            return 1;
+        }
+
+        Game game;
+        std::string line = std::to_string(g) + " " + resultName(result) + " random " +
+                           std::to_string(randomPlies) + ":";
+        for (size_t i = 0; i < plies; i++, pos += 4) {
+            Move move;
+            move.data = static_cast<uint16_t>(getLE(&data[pos], 2));
+            int score = static_cast<int16_t>(getLE(&data[pos + 2], 2));
+            line += " " + game.moveToAlgebraic(move);
+            if (static_cast<int>(i) >= randomPlies) line += "(" + std::to_string(score) + ")";
+        }
+        std::printf("%s\n", line.c_str());
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "--dump") == 0) {
+        return dumpRecords(argc > 2 ? argv[2] : "selfplay.bin");
+    }
+
+    int gameCount = argc > 1 ? std::atoi(argv[1]) : 100;
+    long long nodes = argc > 2 ? std::atoll(argv[2]) : 20000;
+    int threadCount = argc > 3 ? std::atoi(argv[3])
+                               : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::string output = argc > 4 ? argv[4] : "selfplay.bin";
+    int randomPlies = argc > 5 ? std::atoi(argv[5]) : 4;
+    uint32_t seed = argc > 6 ? static_cast<uint32_t>(std::strtoul(argv[6], nullptr, 10)) : 1;
+
+    if (gameCount < 1 || nodes < 1 || threadCount < 1 || randomPlies < 0 || randomPlies > 255) {
+        std::fprintf(stderr, "usage: selfplay [games] [nodes] [threads] [output] [random plies] [seed]\n"
+                             "       selfplay --dump [file]\n");
+        return 1;
+    }
+    threadCount = std::min(threadCount, gameCount);
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Workers take game numbers from a shared counter and fill their slots,
+    // so the file is in game order however the games interleave
+    std::vector<GameRecord> games(gameCount);
+    std::atomic<int> nextGame{0};
+    std::vector<std::thread> workers;
+    for (int w = 0; w < threadCount; w++) {
+        workers.emplace_back([&]() {
+            AI ai;
+            ai.setMultiPV(1);
+            ai.setMaxDepth(MAX_PLY - 1);
+            ai.setTimeLimit(0);
+            ai.setNodeLimit(static_cast<uint64_t>(nodes));
+
+            for (int g = nextGame++; g < gameCount; g = nextGame++) {
+                games[g] = playGame(ai, randomPlies, seed * 1000003u + static_cast<uint32_t>(g));
+            }
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    int whiteWins = 0, blackWins = 0, draws = 0;
+    size_t plies = 0;
+    for (const GameRecord& game : games) {
+        plies += game.moves.size();
+        if (game.result == GameResult::BLACK_WINS) blackWins++;
+        else if (game.result == GameResult::DRAW_STALEMATE) draws++;
+        else if (game.result != GameResult::ONGOING) whiteWins++;
+    }
+
+    if (!writeRecords(output, games)) {
+        std::fprintf(stderr, "cannot write %s\n", output.c_str());
+        return 1;
+    }
+
+    std::printf("played %d games (%zu plies) on %d threads in %lld ms: "
+                "white %d, black %d, draws %d -> %s\n",
+                gameCount, plies, threadCount, static_cast<long long>(elapsed),
+                whiteWins, blackWins, draws, output.c_str());
+    return 0;
+}
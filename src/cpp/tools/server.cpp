@@ -0,0 +1,357 @@
+// Headless engine server speaking a UCI-like line protocol on stdin/stdout,
+// for driving the engine from scripts and test harnesses on other machines
+//
+// Usage: server [tablebase] [book]
+//
+// Commands:
+//   uci, isready, ucinewgame, quit
+//   setoption name Threads|Hash|MultiPV value <n>
+//   position startpos|fen <fen> [moves <move>...]   (FEN as Game::toFen)
+//   go [depth <n>] [movetime <ms>] [nodes <n>] [wtime <ms> btime <ms>
+//      winc <ms> binc <ms>] [infinite] [ponder]
+//   stop, ponderhit
+//   batch [depth <n>] [nodes <n>], then one FEN a line and "end": analyzes
+//      them all with the shared queue, printing "result <index> <depth>
+//      score cp <n> bestmove <move> nodes <n>" as each finishes
+//   d  prints the current position's FEN
+//
+// Scores are from the side to move's point of view, as in UCI. Searches
+// run in the background, so stop and ponderhit are handled mid-search;
+// bestmove is printed when one ends, after ponderhit or stop if pondering,
+// and is 0000 at once on a finished game.
+
+#include "../ai.h"
+#include "../book.h"
+#include "../tablebase.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+using namespace PigsAndFarmers;
+
+namespace {
+
+constexpr int DEFAULT_BATCH_DEPTH = 10;
+
+// Search and batch callbacks print from the search thread
+std::mutex outputMutex;
+
+void send(const std::string& line) {
+    std::lock_guard<std::mutex> lock(outputMutex);
+    std::fputs(line.c_str(), stdout);
+    std::fputc('\n', stdout);
+    std::fflush(stdout);
+}
+
+std::string scoreString(int score, Side side) {
+    // Engine scores are White's point of view
+    if (side == BLACK) score = -score;
+    if (score > 90000) return "mate " + std::to_string((MATE_SCORE - score + 1) / 2);
+    if (score < -90000) return "mate " + std::to_string(-(MATE_SCORE + score + 1) / 2);
+    return "cp " + std::to_string(score);
+}
+
+class Server {
+public:
+    Server(const Tablebase* tablebase, const OpeningBook* book) {
+        ai.setMultiPV(1);
+        ai.setTablebase(tablebase);
+        ai.setBook(book);
+    }
+
+    ~Server() { finishSearch(); }
+
+    // Returns false on quit
+    bool handle(const std::string& line);
+
+private:
+    AI ai;
+    Game game;
+    Game searchGame;  // Root of the running search, for the info lines
+    std::thread reporter;
+
+    // Batch input collected between "batch" and "end"
+    bool readingBatch = false;
+    int batchDepth = DEFAULT_BATCH_DEPTH;
+    uint64_t batchNodes = 0;
+    std::vector<BatchPosition> batchPositions;
+    std::vector<int> batchIndex;    // Input line number of each position
+    std::vector<int> batchInvalid;  // Input line numbers of bad FENs
+    int batchCount = 0;
+
+    void setPosition(std::istringstream& in);
+    void go(std::istringstream& in);
+    void setOption(std::istringstream& in);
+    void startBatch(std::istringstream& in);
+    void addBatchPosition(const std::string& line);
+    void runBatch();
+    void sendInfo(const SearchInfo& info);
+    void finishSearch();
+    void waitThenReport(bool printBestMove);
+};
+
+bool Server::handle(const std::string& line) {
+    if (readingBatch) {
+        if (line == "end") runBatch();
+        else addBatchPosition(line);
+        return true;
+    }
+
+    std::istringstream in(line);
+    std::string command;
+    if (!(in >> command)) return true;
+
+    if (command == "uci") {
+        send("id name Pigs and Farmers");
+        send("option name Threads type spin default 1 min 1 max " + std::to_string(MAX_THREADS));
+        send("option name Hash type spin default " + std::to_string(DEFAULT_HASH_MB) +
+             " min 1 max " + std::to_string(MAX_HASH_MB));
+        send("option name MultiPV type spin default 1 min 1 max " + std::to_string(MAX_MULTIPV));
+        send("uciok");
+    } else if (command == "isready") {
+        send("readyok");
+    } else if (command == "ucinewgame") {
+        finishSearch();
+        ai.clearHash();
+        game.reset();
+    } else if (command == "setoption") {
+        setOption(in);
+    } else if (command == "position") {
+        finishSearch();
+        setPosition(in);
+    } else if (command == "go") {
+        go(in);
+    } else if (command == "stop") {
+        ai.stopSearch();
+    } else if (command == "ponderhit") {
+        ai.ponderHit();
+    } else if (command == "batch") {
+        startBatch(in);
+    } else if (command == "d") {
+        send(game.toFen());
+    } else if (command == "quit") {
+        return false;
+    } else {
+        send("info string unknown command " + command);
+    }
+    return true;
+}
+
+void Server::setPosition(std::istringstream& in) {
+    std::string token;
+    in >> token;
+
+    Game next;
+    if (token == "fen") {
+        std::string fen;
+        while (in >> token && token != "moves") fen += (fen.empty() ? "" : " ") + token;
+        if (!next.setFromFen(fen)) {
+            send("info string invalid fen");
+            return;
+        }
+    } else if (token == "startpos") {
+        in >> token;
+    } else {
+        send("info string expected startpos or fen");
+        return;
+    }
+
+    // token is "moves" here if any follow
+    while (in >> token) {
+        Move move = next.algebraicToMove(token);
+        if (!move.isValid() || !next.makeMove(move)) {
+            send("info string illegal move " + token);
+            return;
+        }
+    }
+    game = next;
+}
+
+void Server::go(std::istringstream& in) {
+    finishSearch();
+
+    // A finished game has nothing to search, whoever is to move
+    if (game.isGameOver()) {
+        send("bestmove 0000");
+        return;
+    }
+
+    int depth = MAX_PLY - 1;
+    int moveTime = 0;
+    int clock[2] = { 0, 0 };
+    int increment[2] = { 0, 0 };
+    uint64_t nodes = 0;
+    bool ponder = false;
+
+    std::string token;
+    while (in >> token) {
+        if (token == "depth") in >> depth;
+        else if (token == "movetime") in >> moveTime;
+        else if (token == "nodes") in >> nodes;
+        else if (token == "wtime") in >> clock[WHITE];
+        else if (token == "btime") in >> clock[BLACK];
+        else if (token == "winc") in >> increment[WHITE];
+        else if (token == "binc") in >> increment[BLACK];
+        else if (token == "ponder") ponder = true;
+        // "infinite" is the default with no limits
+    }
+
+    // A share of the clock when playing a timed game; the time manager
+    // treats the limit as its hard budget
+    Side side = game.getSideToMove();
+    if (moveTime == 0 && clock[side] > 0) {
+        moveTime = std::max(1, clock[side] / 20 + increment[side] / 2);
+    }
+
+    ai.setMaxDepth(std::max(1, std::min(depth, MAX_PLY - 1)));
+    ai.setTimeLimit(moveTime);
+    ai.setNodeLimit(nodes);
+    ai.setCallback([this](const SearchInfo& info) { sendInfo(info); });
+
+    searchGame = game;
+    if (ponder) ai.startPonder(game);
+    else ai.startSearch(game);
+    reporter = std::thread(&Server::waitThenReport, this, true);
+}
+
+void Server::setOption(std::istringstream& in) {
+    std::string token, name;
+    int value = 0;
+    while (in >> token) {
+        if (token == "name") in >> name;
+        else if (token == "value") in >> value;
+    }
+
+    finishSearch();
+    if (name == "Threads") ai.setThreads(value);
+    else if (name == "Hash") ai.setHashSizeMB(value);
+    else if (name == "MultiPV") ai.setMultiPV(value);
+    else send("info string unknown option " + name);
+}
+
+void Server::startBatch(std::istringstream& in) {
+    finishSearch();
+
+    batchDepth = DEFAULT_BATCH_DEPTH;
+    batchNodes = 0;
+    std::string token;
+    while (in >> token) {
+        if (token == "depth") in >> batchDepth;
+        else if (token == "nodes") in >> batchNodes;
+    }
+    batchDepth = std::max(1, std::min(batchDepth, MAX_PLY - 1));
+    batchPositions.clear();
+    batchIndex.clear();
+    batchInvalid.clear();
+    batchCount = 0;
+    readingBatch = true;
+}
+
+void Server::addBatchPosition(const std::string& line) {
+    // Invalid FENs keep their place in the numbering and are reported with
+    // depth -1, as analyzeBatch() reports invalid positions
+    int index = batchCount++;
+    Game position;
+    if (!position.setFromFen(line)) {
+        batchInvalid.push_back(index);
+        return;
+    }
+    batchPositions.push_back({ position.getPawns(), position.getQueen(), position.getSideToMove() });
+    batchIndex.push_back(index);
+}
+
+void Server::runBatch() {
+    readingBatch = false;
+    for (int index : batchInvalid) send("result " + std::to_string(index) + " -1 nodes 0");
+
+    ai.setTimeLimit(0);
+    ai.setNodeLimit(0);
+
+    std::vector<Side> sides;
+    for (const BatchPosition& p : batchPositions) sides.push_back(p.side);
+
+    ai.startBatch(std::move(batchPositions), batchDepth, batchNodes,
+                  [sides, indices = batchIndex](const BatchResult& r) {
+        Game position;
+        std::string line = "result " + std::to_string(indices[r.index]) + " " + std::to_string(r.depth);
+        if (r.depth > 0) {
+            line += " score " + scoreString(r.score, sides[r.index]) +
+                    " bestmove " + position.moveToAlgebraic(r.bestMove);
+        }
+        line += " nodes " + std::to_string(r.nodes);
+        send(line);
+    });
+    batchPositions.clear();
+    reporter = std::thread(&Server::waitThenReport, this, false);
+}
+
+void Server::sendInfo(const SearchInfo& info) {
+    Side side = searchGame.getSideToMove();
+    for (size_t i = 0; i < info.pvLines.size(); i++) {
+        const PVLine& line = info.pvLines[i];
+        std::string out = "info multipv " + std::to_string(i + 1) +
+                          " depth " + std::to_string(line.depth) +
+                          " seldepth " + std::to_string(info.selDepth) +
+                          " score " + scoreString(line.score, side) +
+                          " nodes " + std::to_string(info.nodes) +
+                          " nps " + std::to_string(info.nps) +
+                          " time " + std::to_string(info.timeMs) + " pv";
+        for (Move move : line.moves) out += " " + searchGame.moveToAlgebraic(move);
+        send(out);
+    }
+}
+
+// Stops the running search or batch and waits for its report, so the
+// reporter thread is the only caller of waitSearch()
+void Server::finishSearch() {
+    if (!reporter.joinable()) return;
+    ai.stopSearch();
+    reporter.join();
+}
+
+void Server::waitThenReport(bool printBestMove) {
+    // A ponder search holds its result until ponderhit or stop
+    while (ai.isSearching() || ai.isPondering()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    SearchInfo info = ai.waitSearch();
+
+    if (!printBestMove) {
+        send("batchdone");
+        return;
+    }
+
+    Move best = ai.getBestMove();
+    if (!best.isValid()) {
+        send("bestmove 0000");
+        return;
+    }
+    std::string out = "bestmove " + searchGame.moveToAlgebraic(best);
+    if (!info.pvLines.empty() && info.pvLines[0].moves.size() > 1) {
+        out += " ponder " + searchGame.moveToAlgebraic(info.pvLines[0].moves[1]);
+    }
+    send(out);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Tablebase tablebase;
+    OpeningBook book;
+    bool haveTablebase = argc > 1 && tablebase.loadFile(argv[1]);
+    bool haveBook = argc > 2 && book.loadFile(argv[2]);
+    if (argc > 1 && !haveTablebase) std::fprintf(stderr, "cannot read tablebase %s\n", argv[1]);
+    if (argc > 2 && !haveBook) std::fprintf(stderr, "cannot read book %s\n", argv[2]);
+
+    Server server(haveTablebase ? &tablebase : nullptr, haveBook ? &book : nullptr);
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!server.handle(line)) break;
+    }
+    return 0;
+}
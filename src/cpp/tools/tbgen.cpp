@@ -0,0 +1,45 @@
+// Native tablebase generator
+//
+// Usage: tbgen [maxPawns] [output]
+//   Solves every position with up to maxPawns pawns (default 3) and writes
+//   the tables to output (default public/tablebase.bin), which the engine
+//   worker fetches at startup.
+
+#include "../tablebase.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace PigsAndFarmers;
+
+int main(int argc, char** argv) {
+    int maxPawns = argc > 1 ? std::atoi(argv[1]) : 3;
+    std::string output = argc > 2 ? argv[2] : "public/tablebase.bin";
+
+    if (maxPawns < 1 || maxPawns > Tablebase::MAX_PAWNS) {
+        std::fprintf(stderr, "maxPawns must be between 1 and %d\n", Tablebase::MAX_PAWNS);
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    Tablebase tb;
+    if (!tb.generate(maxPawns)) {
+        std::fprintf(stderr, "generation failed: distance to mate overflows the value byte\n");
+        return 1;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    if (!tb.saveFile(output)) {
+        std::fprintf(stderr, "cannot write %s\n", output.c_str());
+        return 1;
+    }
+
+    size_t positions = 0;
+    for (int k = 1; k <= maxPawns; k++) positions += Tablebase::tableSize(k);
+    std::printf("generated %d-pawn tablebase: %zu positions at %d bits in %lld ms -> %s\n",
+                maxPawns, positions, tb.getValueBits(), static_cast<long long>(elapsed), output.c_str());
+    return 0;
+}
@@ -0,0 +1,258 @@
+// Texel-style tuner for the evaluation weights (EvalParams in eval.h)
+//
+// Usage: tune [--passes n] [records...]
+//   Reads self-play game records (default selfplay.bin, see selfplay.cpp)
+//   and fits the weights so that a sigmoid of the static score predicts the
+//   game results: a local search steps each weight up or down while the
+//   mean squared error drops, refitting the sigmoid scale K after every
+//   pass, for up to n passes (default 20). Prints the result in the layout
+//   of Eval::PARAMS, to paste over it.
+//
+//   Positions from the random opening plies, finished games and those the
+//   search scored as mates are skipped. The score is linear in the weights,
+//   so each position's feature counts (Eval::features) are extracted once
+//   and every error measurement is a batch of dot products.
+
+#include "../ai.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+
+using namespace PigsAndFarmers;
+
+namespace {
+
+using Weights = std::array<int, EVAL_PARAM_COUNT>;
+
+// Feature counts of every position, EVAL_PARAM_COUNT per position (all fit
+// in a byte), and each position's game result for White: 1, 0.5 or 0
+struct TrainingSet {
+    std::vector<int8_t> counts;
+    std::vector<float> results;
+
+    size_t size() const { return results.size(); }
+};
+
+Weights flatten(const EvalParams& params) {
+    Weights w{};
+    int n = 0;
+    forEachParam(params, [&](const char*, int v) { w[n++] = v; });
+    return w;
+}
+
+EvalParams unflatten(const Weights& w) {
+    EvalParams params{};
+    int n = 0;
+    forEachParam(params, [&](const char*, int& v) { v = w[n++]; });
+    return params;
+}
+
+uint64_t getLE(const uint8_t* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) value |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return value;
+}
+
+float resultForWhite(GameResult result) {
+    switch (result) {
+        case GameResult::WHITE_WINS_PROMOTION:
+        case GameResult::WHITE_WINS_CAPTURE: return 1.0f;
+        case GameResult::BLACK_WINS: return 0.0f;
+        default: return 0.5f;
+    }
+}
+
+bool loadRecords(const std::string& path, TrainingSet& set) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                              std::istreambuf_iterator<char>());
+    if (data.size() < 12 || std::memcmp(data.data(), "PFGR", 4) != 0 || data[4] != 1) {
+        return false;
+    }
+
+    uint32_t games = static_cast<uint32_t>(getLE(&data[8], 4));
+    size_t pos = 12;
+    for (uint32_t g = 0; g < games; g++) {
+        if (data.size() - pos < 4) return false;
+        GameResult result = static_cast<GameResult>(data[pos]);
+        int randomPlies = data[pos + 1];
+        size_t plies = getLE(&data[pos + 2], 2);
+        pos += 4;
+        if (data.size() - pos < plies * 4) return false;
+        if (result == GameResult::ONGOING) {
+            pos += plies * 4;
+            continue;
+        }
+
+        // Each ply's score belongs to the position it was searched from
+        Game game;
+        for (size_t i = 0; i < plies; i++, pos += 4) {
+            Move move;
+            move.data = static_cast<uint16_t>(getLE(&data[pos], 2));
+            int score = static_cast<int16_t>(getLE(&data[pos + 2], 2));
+
+            EvalParams counts;
+            if (static_cast<int>(i) >= randomPlies && std::abs(score) <= STORED_MATE_BOUND &&
+                Eval::features(game.getPawns(), game.getQueen(), game.getSideToMove(), counts)) {
+                forEachParam(counts, [&](const char*, int c) {
+                    set.counts.push_back(static_cast<int8_t>(c));
+                });
+                set.results.push_back(resultForWhite(result));
+            }
+            if (!game.makeMove(move)) return false;
+        }
+    }
+    return true;
+}
+
+float sigmoid(float k, int score) {
+    return 1.0f / (1.0f + std::pow(10.0f, -k * score / 400.0f));
+}
+
+// Mean squared error of the predicted results, split over the cores
+double meanError(const TrainingSet& set, const Weights& w, float k) {
+    unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<double> sums(threadCount, 0.0);
+    std::vector<std::thread> workers;
+    size_t chunk = (set.size() + threadCount - 1) / threadCount;
+
+    for (unsigned t = 0; t < threadCount; t++) {
+        workers.emplace_back([&, t]() {
+            size_t end = std::min(set.size(), (t + 1) * chunk);
+            double sum = 0.0;
+            for (size_t i = t * chunk; i < end; i++) {
+                const int8_t* c = &set.counts[i * EVAL_PARAM_COUNT];
+                int score = 0;
+                for (int j = 0; j < EVAL_PARAM_COUNT; j++) score += w[j] * c[j];
+                double diff = set.results[i] - sigmoid(k, score);
+                sum += diff * diff;
+            }
+            sums[t] = sum;
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+
+    double total = 0.0;
+    for (double s : sums) total += s;
+    return total / set.size();
+}
+
+// Golden-section search for the K that best fits the given weights
+float fitScale(const TrainingSet& set, const Weights& w) {
+    const double ratio = (std::sqrt(5.0) - 1) / 2;
+    double lo = 0.001, hi = 5.0;
+    for (int i = 0; i < 30; i++) {
+        double a = hi - ratio * (hi - lo);
+        double b = lo + ratio * (hi - lo);
+        if (meanError(set, w, static_cast<float>(a)) < meanError(set, w, static_cast<float>(b))) hi = b;
+        else lo = a;
+    }
+    return static_cast<float>((lo + hi) / 2);
+}
+
+void printParams(const EvalParams& params) {
+    // Group the flat weights back into the fields they came from
+    std::vector<std::pair<std::string, std::vector<int>>> fields;
+    forEachParam(params, [&](const char* name, int v) {
+        if (fields.empty() || fields.back().first != name) fields.push_back({ name, {} });
+        fields.back().second.push_back(v);
+    });
+
+    auto list = [](const std::vector<int>& v, size_t from, size_t to) {
+        std::string s = "{ ";
+        for (size_t i = from; i < to; i++) s += std::to_string(v[i]) + (i + 1 < to ? ", " : " }");
+        return s;
+    };
+
+    std::printf("constexpr EvalParams PARAMS = {\n");
+    for (size_t f = 0; f < fields.size(); f++) {
+        const std::string& name = fields[f].first;
+        const std::vector<int>& v = fields[f].second;
+        const char* comma = f + 1 < fields.size() ? "," : "";
+        if (v.size() == 1) {
+            std::printf("    %d%s  // %s\n", v[0], comma, name.c_str());
+        } else if (v.size() == 8) {
+            std::printf("    %s%s  // %s\n", list(v, 0, 8).c_str(), comma, name.c_str());
+        } else {
+            std::printf("    {{ %s,  // %s, White to move\n", list(v, 0, 8).c_str(), name.c_str());
+            std::printf("       %s }}%s  // %s, queen to move\n", list(v, 8, 16).c_str(), comma, name.c_str());
+        }
+    }
+    std::printf("};\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int passes = 20;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--passes") == 0 && i + 1 < argc) passes = std::atoi(argv[++i]);
+        else inputs.push_back(argv[i]);
+    }
+    if (inputs.empty()) inputs.push_back("selfplay.bin");
+
+    TrainingSet set;
+    for (const std::string& path : inputs) {
+        if (!loadRecords(path, set)) {
+            std::fprintf(stderr, "cannot read game records from %s\n", path.c_str());
+            return 1;
+        }
+    }
+    if (set.size() == 0) {
+        std::fprintf(stderr, "no positions to tune on\n");
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Weights no position uses stay as they are
+    std::array<bool, EVAL_PARAM_COUNT> used{};
+    for (size_t i = 0; i < set.size(); i++) {
+        for (int j = 0; j < EVAL_PARAM_COUNT; j++) {
+            if (set.counts[i * EVAL_PARAM_COUNT + j] != 0) used[j] = true;
+        }
+    }
+
+    Weights w = flatten(Eval::PARAMS);
+    float k = fitScale(set, w);
+    double best = meanError(set, w, k);
+    double initial = best;
+    std::printf("%zu positions, K = %.3f, error %.6f\n", set.size(), k, best);
+    std::fflush(stdout);
+
+    for (int pass = 1; pass <= passes; pass++) {
+        bool improved = false;
+        for (int j = 0; j < EVAL_PARAM_COUNT; j++) {
+            if (!used[j]) continue;
+            for (int step : { 1, -1 }) {
+                w[j] += step;
+                double error = meanError(set, w, k);
+                if (error < best) {
+                    best = error;
+                    improved = true;
+                    break;
+                }
+                w[j] -= step;
+            }
+        }
+        // Let the scale follow the weights
+        k = fitScale(set, w);
+        best = meanError(set, w, k);
+        std::printf("pass %d: K = %.3f, error %.6f\n", pass, k, best);
+        std::fflush(stdout);
+        if (!improved) break;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::printf("error %.6f -> %.6f in %lld ms\n\n", initial, best, static_cast<long long>(elapsed));
+    printParams(unflatten(w));
+    return 0;
+}
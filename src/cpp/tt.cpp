@@ -0,0 +1,294 @@
+#include "tt.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <new>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace PigsAndFarmers {
+
+namespace {
+
+// On native Linux, tables of a huge page or more start on one and ask for
+// transparent huge pages. The OS hands out big callocs as untouched zero
+// pages, so the first search that touches them takes a fault per 2MB
+// rather than per 4KB.
+#ifdef __linux__
+constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+#endif
+
+constexpr char TT_MAGIC[4] = { 'P', 'F', 'T', 'T' };
+constexpr uint8_t TT_VERSION = 1;
+constexpr size_t TT_HEADER_SIZE = 12;
+
+void putLE(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+uint64_t getLE(const uint8_t* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) value |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return value;
+}
+
+int log2Of(size_t n) {
+    int log = 0;
+    while ((size_t(1) << log) < n) log++;
+    return log;
+}
+
+} // namespace
+
+TranspositionTable::TranspositionTable(int sizeMB)
+    : buckets(nullptr), bucketCount(0), mask(0), age(0), agesSinceSweep(0) {
+    resize(sizeMB);
+}
+
+void TranspositionTable::resize(int sizeMB) {
+    sizeMB = std::max(1, std::min(sizeMB, MAX_HASH_MB));
+
+    // Largest power of two that fits, so the index is a mask, not a modulo
+    size_t target = (static_cast<size_t>(sizeMB) << 20) / sizeof(Bucket);
+    size_t count = 1;
+    while (count * 2 <= target) count *= 2;
+
+    if (count == bucketCount) {
+        clear();
+        return;
+    }
+
+    // Free before allocating to keep the peak down. Zeroed atomics are
+    // empty entries, so the fresh table needs no clearing pass.
+    memory.reset();
+    size_t bytes = count * sizeof(Bucket);
+    size_t alignment = alignof(Bucket);
+#ifdef __linux__
+    if (bytes >= HUGE_PAGE_SIZE) alignment = HUGE_PAGE_SIZE;
+#endif
+    memory.reset(std::calloc(bytes + alignment - 1, 1));
+    if (!memory) throw std::bad_alloc();
+    uintptr_t address = reinterpret_cast<uintptr_t>(memory.get());
+    address = (address + alignment - 1) & ~(uintptr_t(alignment) - 1);
+    buckets = reinterpret_cast<Bucket*>(address);
+#ifdef __linux__
+    if (alignment == HUGE_PAGE_SIZE) madvise(buckets, bytes, MADV_HUGEPAGE);
+#endif
+    bucketCount = count;
+    mask = count - 1;
+    age = 0;
+    agesSinceSweep = 0;
+}
+
+void TranspositionTable::advanceAge(int steps) {
+    if (agesSinceSweep + steps > AGE_MASK) {
+        // Only the current age survives a single step (as the next one's
+        // previous age)
+        for (size_t i = 0; i < bucketCount; i++) {
+            for (auto& e : buckets[i].entries) {
+                uint64_t data = e.load(std::memory_order_relaxed);
+                if (data != 0 && (steps > 1 || unpack(data).age != age)) {
+                    e.store(0, std::memory_order_relaxed);
+                }
+            }
+        }
+        agesSinceSweep = 0;
+    }
+    age = (age + steps) & AGE_MASK;
+    agesSinceSweep += steps;
+}
+
+uint64_t TranspositionTable::pack(uint16_t key, const TTEntry& entry) {
+    return static_cast<uint64_t>(key) << 48 |
+           static_cast<uint64_t>(entry.bestMove.data) << 32 |
+           static_cast<uint64_t>(static_cast<uint16_t>(encodeStoredScore(entry.score))) << 16 |
+           static_cast<uint64_t>(static_cast<uint8_t>(entry.depth)) << 8 |
+           static_cast<uint64_t>((entry.age & AGE_MASK) << 2 | (entry.flag & 3));
+}
+
+TTEntry TranspositionTable::unpack(uint64_t data) {
+    TTEntry entry;
+    entry.bestMove.data = static_cast<uint16_t>(data >> 32);
+    entry.score = decodeStoredScore(static_cast<int16_t>(data >> 16));
+    entry.depth = static_cast<int8_t>(data >> 8);
+    entry.age = static_cast<uint8_t>((data >> 2) & AGE_MASK);
+    entry.flag = static_cast<uint8_t>(data & 3);
+    return entry;
+}
+
+bool TranspositionTable::probe(uint64_t hash, TTEntry& entry) const {
+    const Bucket& bucket = bucketFor(hash);
+    uint16_t key = keyOf(hash);
+
+    for (const auto& e : bucket.entries) {
+        uint64_t data = e.load(std::memory_order_relaxed);
+        if (data == 0 || entryKey(data) != key) continue;
+
+        entry = unpack(data);
+
+        // Only use entries from current or recent searches
+        // Old entries might have incorrect scores due to different game states
+        uint8_t prevAge = (age - 1) & AGE_MASK;
+        return entry.age == age || entry.age == prevAge;
+    }
+    return false;
+}
+
+bool TranspositionTable::store(uint64_t hash, int score, int depth, TTFlag flag, Move bestMove) {
+    Bucket& bucket = bucketFor(hash);
+    uint16_t key = keyOf(hash);
+
+    // Pick the slot: this position's own entry or an empty one if present,
+    // otherwise the least valuable entry, where each search of age costs
+    // as much as 8 plies of depth
+    int victim = 0;
+    int worst = INT_MAX;
+    bool evicts = true;
+    for (int i = 0; i < BUCKET_ENTRIES; i++) {
+        uint64_t data = bucket.entries[i].load(std::memory_order_relaxed);
+
+        if (data == 0) {
+            victim = i;
+            evicts = false;
+            break;
+        }
+
+        TTEntry old = unpack(data);
+        if (entryKey(data) == key) {
+            // Same position: replace if deeper or old entry
+            if (depth < old.depth && old.age == age) return false;
+            victim = i;
+            evicts = false;
+            break;
+        }
+
+        int relativeAge = (age - old.age) & AGE_MASK;
+        int value = old.depth - 8 * relativeAge;
+        if (value < worst) {
+            worst = value;
+            victim = i;
+        }
+    }
+
+    TTEntry entry;
+    entry.score = score;
+    entry.depth = static_cast<int8_t>(depth);
+    entry.flag = flag;
+    entry.bestMove = bestMove;
+    entry.age = age;
+
+    bucket.entries[victim].store(pack(key, entry), std::memory_order_relaxed);
+    return evicts;
+}
+
+std::vector<uint8_t> TranspositionTable::serialize() const {
+    std::vector<uint8_t> data(TT_HEADER_SIZE, 0);
+    std::memcpy(data.data(), TT_MAGIC, 4);
+    data[4] = TT_VERSION;
+    data[5] = static_cast<uint8_t>(log2Of(bucketCount));
+
+    uint8_t prevAge = (age - 1) & AGE_MASK;
+    uint32_t total = 0;
+    size_t lastBucket = 0;
+
+    for (size_t b = 0; b < bucketCount; b++) {
+        uint64_t words[BUCKET_ENTRIES];
+        int count = 0;
+        for (const auto& e : buckets[b].entries) {
+            uint64_t word = e.load(std::memory_order_relaxed);
+            if (word == 0) continue;
+            uint8_t entryAge = unpack(word).age;
+            if (entryAge == age || entryAge == prevAge) words[count++] = word;
+        }
+        if (count == 0) continue;
+
+        // Bucket index as a delta from the last one written, 7 bits a byte
+        size_t delta = b - lastBucket;
+        lastBucket = b;
+        do {
+            data.push_back(static_cast<uint8_t>((delta & 0x7F) | (delta > 0x7F ? 0x80 : 0)));
+            delta >>= 7;
+        } while (delta);
+
+        data.push_back(static_cast<uint8_t>(count));
+        for (int i = 0; i < count; i++) putLE(data, words[i], 8);
+        total += count;
+    }
+
+    for (int i = 0; i < 4; i++) data[8 + i] = static_cast<uint8_t>(total >> (8 * i));
+    return data;
+}
+
+bool TranspositionTable::load(const uint8_t* data, size_t size) {
+    if (size < TT_HEADER_SIZE || std::memcmp(data, TT_MAGIC, 4) != 0 ||
+        data[4] != TT_VERSION || data[5] < log2Of(bucketCount) || data[5] >= 48) {
+        return false;
+    }
+
+    size_t savedBuckets = size_t(1) << data[5];
+    uint32_t remaining = static_cast<uint32_t>(getLE(data + 8, 4));
+    const uint8_t* p = data + TT_HEADER_SIZE;
+    const uint8_t* end = data + size;
+    size_t bucket = 0;
+
+    // Parse and check the whole snapshot before storing anything, so a
+    // malformed one leaves the table as it was
+    std::vector<std::pair<uint64_t, uint64_t>> loaded;  // Hash, packed entry
+    loaded.reserve(std::min<size_t>(remaining, size / 8));
+
+    while (remaining > 0) {
+        size_t delta = 0;
+        int shift = 0;
+        do {
+            if (p == end || shift > 42) return false;
+            delta |= static_cast<size_t>(*p & 0x7F) << shift;
+            shift += 7;
+        } while (*p++ & 0x80);
+
+        bucket += delta;
+        if (bucket >= savedBuckets || p == end) return false;
+        int count = *p++;
+        if (count < 1 || count > BUCKET_ENTRIES || count > static_cast<int>(remaining) ||
+            static_cast<size_t>(end - p) < static_cast<size_t>(count) * 8) {
+            return false;
+        }
+
+        // The saved bucket index holds the low bits of the hash, and entries
+        // keep the top 16, which is all store() looks at
+        for (int i = 0; i < count; i++) {
+            uint64_t word = getLE(p, 8);
+            p += 8;
+            loaded.push_back({ static_cast<uint64_t>(entryKey(word)) << 48 | bucket, word });
+        }
+        remaining -= count;
+    }
+    if (p != end) return false;
+
+    for (const auto& saved : loaded) {
+        TTEntry entry = unpack(saved.second);
+        store(saved.first, entry.score, entry.depth, static_cast<TTFlag>(entry.flag), entry.bestMove);
+    }
+    return true;
+}
+
+bool TranspositionTable::loadFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                              std::istreambuf_iterator<char>());
+    return load(data.data(), data.size());
+}
+
+bool TranspositionTable::saveFile(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+
+    std::vector<uint8_t> data = serialize();
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return static_cast<bool>(out);
+}
+
+} // namespace PigsAndFarmers
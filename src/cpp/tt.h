@@ -0,0 +1,142 @@
+#ifndef TT_H
+#define TT_H
+
+#include "game.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace PigsAndFarmers {
+
+// Transposition table entry types
+enum TTFlag : uint8_t {
+    TT_EXACT = 0,
+    TT_ALPHA = 1,  // Upper bound
+    TT_BETA = 2    // Lower bound
+};
+
+// Decoded transposition table entry
+struct TTEntry {
+    int score;
+    int8_t depth;
+    uint8_t flag;
+    Move bestMove;
+    uint8_t age;
+
+    bool isValid(int d) const {
+        return depth >= d;
+    }
+};
+
+// Table size limits. The WASM heap is capped at 256MB (MAXIMUM_MEMORY in
+// the Makefile), so the table may take at most half of it.
+constexpr int DEFAULT_HASH_MB = 16;
+constexpr int MAX_HASH_MB = 128;
+
+// Mate score the table encodes compactly (must equal MATE_SCORE in ai.h)
+constexpr int TT_MATE_SCORE = 100000;
+
+// Scores stored in 16 bits (the TT, the opening book and self-play
+// records). Mate scores (within 1000 of TT_MATE_SCORE) are folded to the
+// ends of the int16 range by their distance to mate, so they survive the
+// round trip exactly; other scores are clamped below STORED_MATE_BOUND.
+constexpr int STORED_MATE = 32767;
+constexpr int STORED_MATE_BOUND = STORED_MATE - 1000;
+
+inline int16_t encodeStoredScore(int score) {
+    constexpr int mateBound = TT_MATE_SCORE - 1000;
+    if (score > mateBound) return static_cast<int16_t>(STORED_MATE - (TT_MATE_SCORE - score));
+    if (score < -mateBound) return static_cast<int16_t>(-STORED_MATE + (TT_MATE_SCORE + score));
+    return static_cast<int16_t>(std::max(-STORED_MATE_BOUND, std::min(STORED_MATE_BOUND, score)));
+}
+
+inline int decodeStoredScore(int16_t stored) {
+    if (stored > STORED_MATE_BOUND) return TT_MATE_SCORE - (STORED_MATE - stored);
+    if (stored < -STORED_MATE_BOUND) return -TT_MATE_SCORE + (stored + STORED_MATE);
+    return stored;
+}
+
+// Lock-free transposition table shared by all search threads.
+//
+// Positions map to 64-byte, cache-line-aligned buckets of eight entries.
+// Each entry is packed into a single 64-bit word (so racing threads can't
+// tear it) holding the top 16 bits of the hash as a key check:
+//
+//   key(16) | move(16) | score(16) | depth(8) | age(6) bound(2)
+class TranspositionTable {
+public:
+    explicit TranspositionTable(int sizeMB = DEFAULT_HASH_MB);
+
+    // Reallocates and clears. Rounds down to a power-of-two bucket count.
+    // The memory comes zeroed from calloc, so there is no separate clearing
+    // pass. Native builds also get fresh pages from the OS, which commits
+    // only those the search touches (huge pages on Linux, see tt.cpp). On
+    // the WASM heap, calloc zeroes reused memory itself.
+    void resize(int sizeMB);
+    int getSizeMB() const { return static_cast<int>((bucketCount * sizeof(Bucket)) >> 20); }
+
+    // Steps the age past the previous search's too, so probe() accepts
+    // nothing stored before. O(1) apart from the sweep in advanceAge().
+    void clear() { advanceAge(2); }
+    void newSearch() { advanceAge(1); }
+
+    bool probe(uint64_t hash, TTEntry& entry) const;
+    // Returns true if the entry evicted another position's
+    bool store(uint64_t hash, int score, int depth, TTFlag flag, Move bestMove);
+
+    // Snapshot of the entries probe() would still accept, so a later
+    // session can start warm. Not safe while a search is running.
+    //
+    // Format (little endian): char[4] "PFTT", uint8 version, uint8 log2 of
+    // the bucket count, uint16 reserved, uint32 entry count, then for each
+    // non-empty bucket: varint bucket index delta, uint8 entry count and
+    // the packed entries as uint64s.
+    std::vector<uint8_t> serialize() const;
+    bool saveFile(const std::string& path) const;
+
+    // Merges a snapshot into the table, entries counting as the current
+    // search's. A snapshot from a larger table folds into this one; one
+    // from a smaller table can't be placed and is rejected. A rejected or
+    // malformed snapshot leaves the table unchanged.
+    bool load(const uint8_t* data, size_t size);
+    bool loadFile(const std::string& path);
+
+private:
+    static constexpr int BUCKET_ENTRIES = 8;
+    static constexpr uint8_t AGE_MASK = 0x3F;
+
+    struct alignas(64) Bucket {
+        std::atomic<uint64_t> entries[BUCKET_ENTRIES];
+    };
+
+    struct FreeDeleter {
+        void operator()(void* p) const { std::free(p); }
+    };
+
+    std::unique_ptr<void, FreeDeleter> memory;  // From calloc, unaligned
+    Bucket* buckets;                            // memory rounded up to a cache line
+    size_t bucketCount;
+    size_t mask;
+    uint8_t age;
+    int agesSinceSweep;  // Age steps since any entry the table may hold was written
+
+    // The 6-bit age wraps, so an entry left alone long enough would look
+    // current again. Before the step that could happen, this zeroes every
+    // entry probe() won't accept after the step (a pass over the table once
+    // every AGE_MASK searches).
+    void advanceAge(int steps);
+
+    Bucket& bucketFor(uint64_t hash) const { return buckets[hash & mask]; }
+    static uint16_t keyOf(uint64_t hash) { return static_cast<uint16_t>(hash >> 48); }
+
+    static uint64_t pack(uint16_t key, const TTEntry& entry);
+    static TTEntry unpack(uint64_t data);
+    static uint16_t entryKey(uint64_t data) { return static_cast<uint16_t>(data >> 48); }
+};
+
+} // namespace PigsAndFarmers
+
+#endif // TT_H
@@ -1,8 +1,15 @@
 #include "game.h"
 #include "ai.h"
+#include "tablebase.h"
+#include "book.h"
 #include <emscripten/bind.h>
 #include <emscripten/val.h>
 #include <sstream>
+#include <thread>
+#include <mutex>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 
 using namespace emscripten;
 using namespace PigsAndFarmers;
@@ -10,14 +17,23 @@ using namespace PigsAndFarmers;
 // Global instances
 static Game* game = nullptr;
 static AI* ai = nullptr;
+static Tablebase* tablebase = nullptr;
+static OpeningBook* book = nullptr;
 
 // Initialize the engine
 void init() {
     if (game) delete game;
-    if (ai) delete ai;
+    if (ai) {
+        ai->stopSearch();
+        delete ai;  // Joins a background search
+    }
 
     game = new Game();
     ai = new AI();
+    if (tablebase) {
+        ai->setTablebase(tablebase);
+    }
+    ai->setBook(book);
 }
 
 // Reset the game
@@ -121,94 +137,304 @@ std::string getMoveHistory() {
     return ss.str();
 }
 
-// Global callback for search updates
+// Fixed-layout search info, read by decodeSearchInfo() in types.ts (keep
+// the two in sync). Little-endian, naturally aligned; moves are the raw
+// 16-bit Move encoding (from | to << 6 | flags << 12).
+constexpr int SEARCH_BUFFER_PV_MOVES = 64;  // Longer PVs are truncated
+
+struct PackedPVLine {
+    int32_t score;
+    int16_t depth;
+    uint16_t length;
+    uint16_t moves[SEARCH_BUFFER_PV_MOVES];
+};
+
+enum SearchInfoFlags : uint16_t {
+    SEARCH_INFO_MATE = 1,       // score is a mate score, see mateIn
+    SEARCH_INFO_BEST_MOVE = 2   // Final result: bestMove is set
+};
+
+struct SearchInfoBuffer {
+    int32_t depth;
+    int32_t selDepth;
+    int32_t score;
+    int32_t mateIn;
+    uint64_t nodes;
+    uint64_t nps;
+    int32_t timeMs;
+    uint16_t flags;
+    uint16_t bestMove;
+    uint16_t lineCount;
+    uint16_t reserved;
+    PackedPVLine lines[MAX_MULTIPV];
+};
+
+static_assert(sizeof(PackedPVLine) == 136, "PV line layout is shared with types.ts");
+static_assert(offsetof(SearchInfoBuffer, nodes) == 16, "layout is shared with types.ts");
+static_assert(offsetof(SearchInfoBuffer, timeMs) == 32, "layout is shared with types.ts");
+static_assert(offsetof(SearchInfoBuffer, lines) == 44, "layout is shared with types.ts");
+
+void packSearchInfo(const SearchInfo& info, SearchInfoBuffer& buf) {
+    buf.depth = info.depth;
+    buf.selDepth = info.selDepth;
+    buf.score = info.score;
+    buf.mateIn = info.mateIn();
+    buf.nodes = info.nodes;
+    buf.nps = info.nps;
+    buf.timeMs = info.timeMs;
+    buf.flags = info.isMate() ? SEARCH_INFO_MATE : 0;
+    buf.bestMove = 0;
+    buf.lineCount = static_cast<uint16_t>(std::min<size_t>(info.pvLines.size(), MAX_MULTIPV));
+    buf.reserved = 0;
+
+    for (int i = 0; i < buf.lineCount; i++) {
+        const PVLine& pv = info.pvLines[i];
+        PackedPVLine& line = buf.lines[i];
+        line.score = pv.score;
+        line.depth = static_cast<int16_t>(pv.depth);
+        line.length = static_cast<uint16_t>(
+            std::min<size_t>(pv.moves.size(), SEARCH_BUFFER_PV_MOVES));
+        for (int j = 0; j < line.length; j++) {
+            line.moves[j] = pv.moves[j].data;
+        }
+    }
+}
+
+// The buffer JS reads. Progress updates and results are packed here, and
+// searchInfoView() exposes it without copying.
+static SearchInfoBuffer infoBuffer;
+
+val searchInfoView() {
+    return val(typed_memory_view(sizeof(infoBuffer),
+                                 reinterpret_cast<const uint8_t*>(&infoBuffer)));
+}
+
+void packSearchResult(const SearchInfo& info, Move best) {
+    packSearchInfo(info, infoBuffer);
+    infoBuffer.flags |= SEARCH_INFO_BEST_MOVE;
+    infoBuffer.bestMove = best.data;
+}
+
+// Global callback for search updates, called with a view of infoBuffer
 static val jsCallback = val::undefined();
 
 void cppSearchCallback(const SearchInfo& info) {
     if (jsCallback.isUndefined()) return;
+    packSearchInfo(info, infoBuffer);
+    jsCallback(searchInfoView());
+}
 
-    // Build PV lines JSON
-    std::ostringstream pvSS;
-    pvSS << "[";
-    for (size_t i = 0; i < info.pvLines.size(); i++) {
-        if (i > 0) pvSS << ",";
-        pvSS << "{\"score\":" << info.pvLines[i].score;
-        pvSS << ",\"depth\":" << info.pvLines[i].depth;
-        pvSS << ",\"moves\":[";
-        for (size_t j = 0; j < info.pvLines[i].moves.size(); j++) {
-            if (j > 0) pvSS << ",";
-            pvSS << "[" << info.pvLines[i].moves[j].from() << ","
-                 << info.pvLines[i].moves[j].to() << "]";
-        }
-        pvSS << "]}";
+// Run a search to completion on the calling thread and return a view of the
+// packed result (valid until the next search call). Blocks the thread, so
+// from a worker prefer startSearch().
+val searchBestMove(int depth, int timeMs, int multiPV) {
+    if (!game || !ai || ai->isSearching()) return val::null();
+
+    ai->setMaxDepth(depth);
+    ai->setTimeLimit(timeMs);
+    ai->setMultiPV(multiPV);
+    ai->setCallback(cppSearchCallback);
+
+    SearchInfo info = ai->search(*game);
+    packSearchResult(info, ai->getBestMove());
+    return searchInfoView();
+}
+
+// Background search. The search thread can't call into JS, so it packs the
+// latest iteration into a side buffer and the worker collects it on a
+// timer, staying free to handle stopSearch() and position changes meanwhile.
+static std::mutex searchInfoMutex;
+static SearchInfoBuffer pendingInfo;     // Guarded by searchInfoMutex
+static bool hasPendingInfo = false;      // Guarded by searchInfoMutex
+static bool searchResultPending = false;
+
+void bufferSearchInfo(const SearchInfo& info) {
+    std::lock_guard<std::mutex> lock(searchInfoMutex);
+    packSearchInfo(info, pendingInfo);
+    hasPendingInfo = true;
+}
+
+// Start searching the current position in the background. Returns false
+// if a search is already running.
+bool startSearch(int depth, int timeMs, int multiPV) {
+    if (!game || !ai || ai->isSearching()) return false;
+
+    ai->setMaxDepth(depth);
+    ai->setTimeLimit(timeMs);
+    ai->setMultiPV(multiPV);
+    ai->setCallback(bufferSearchInfo);
+    {
+        std::lock_guard<std::mutex> lock(searchInfoMutex);
+        hasPendingInfo = false;
     }
-    pvSS << "]";
+    searchResultPending = true;
+    ai->startSearch(*game);
+    return true;
+}
 
-    // Build full info JSON
-    std::ostringstream ss;
-    ss << "{";
-    ss << "\"depth\":" << info.depth << ",";
-    ss << "\"selDepth\":" << info.selDepth << ",";
-    ss << "\"score\":" << info.score << ",";
-    ss << "\"nodes\":" << info.nodes << ",";
-    ss << "\"nps\":" << info.nps << ",";
-    ss << "\"timeMs\":" << info.timeMs << ",";
-    ss << "\"isMate\":" << (info.isMate() ? "true" : "false") << ",";
-    ss << "\"mateIn\":" << info.mateIn() << ",";
-    ss << "\"pvLines\":" << pvSS.str();
-    ss << "}";
+// Copy the latest progress update since the last call into the buffer
+// behind searchInfoView(). False if there is none.
+bool pollSearchInfo() {
+    std::lock_guard<std::mutex> lock(searchInfoMutex);
+    if (!hasPendingInfo) return false;
+    infoBuffer = pendingInfo;
+    hasPendingInfo = false;
+    return true;
+}
 
-    jsCallback(val(ss.str()));
+// Pack the final result of the background search into the buffer behind
+// searchInfoView(), once it has finished and its last progress update has
+// been collected (and a ponder search has had its ponderHit()). False
+// until then.
+bool pollSearchResult() {
+    if (!ai || !searchResultPending || ai->isSearching() || ai->isPondering()) return false;
+    {
+        std::lock_guard<std::mutex> lock(searchInfoMutex);
+        if (hasPendingInfo) return false;
+    }
+
+    searchResultPending = false;
+    SearchInfo info = ai->waitSearch();
+    packSearchResult(info, ai->getBestMove());
+    return true;
 }
 
-// Start AI search
-std::string searchBestMove(int depth, int timeMs, int multiPV) {
-    if (!game || !ai) return "{}";
+// Ponder on the opponent's time: search the position after the expected
+// reply (from, to) in the background, collected like startSearch(). The
+// game itself is left alone. When the reply is played, make it with
+// makeMove() and call ponderHit(): the search then uses what is left of
+// timeMs, counted from the start of pondering, and its result comes
+// through pollSearchResult(). On any other reply call stopSearch(), wait
+// for pollSearchResult() and search again; the TT is kept. False if a
+// search is running or the reply isn't legal here.
+bool startPonder(int from, int to, int depth, int timeMs, int multiPV) {
+    if (!game || !ai || ai->isSearching()) return false;
+
+    Game pos = *game;
+    Move reply;
+    for (Move m : pos.generateLegalMoves()) {
+        if (m.from() == from && m.to() == to) reply = m;
+    }
+    if (!reply.isValid() || !pos.makeMove(reply) || pos.isGameOver()) return false;
 
     ai->setMaxDepth(depth);
     ai->setTimeLimit(timeMs);
     ai->setMultiPV(multiPV);
-    ai->setCallback(cppSearchCallback);
+    ai->setCallback(bufferSearchInfo);
+    {
+        std::lock_guard<std::mutex> lock(searchInfoMutex);
+        hasPendingInfo = false;
+    }
+    searchResultPending = true;
+    ai->startPonder(pos);
+    return true;
+}
 
-    SearchInfo info = ai->search(*game);
+// The expected reply was played: turn the ponder search into a normal one.
+// False if there was no ponder search.
+bool ponderHit() {
+    if (!ai || !ai->isPondering()) return false;
+    ai->ponderHit();
+    return true;
+}
 
-    // Return final result
-    std::ostringstream ss;
-    ss << "{";
-    ss << "\"depth\":" << info.depth << ",";
-    ss << "\"selDepth\":" << info.selDepth << ",";
-    ss << "\"score\":" << info.score << ",";
-    ss << "\"nodes\":" << info.nodes << ",";
-    ss << "\"nps\":" << info.nps << ",";
-    ss << "\"timeMs\":" << info.timeMs << ",";
-    ss << "\"isMate\":" << (info.isMate() ? "true" : "false") << ",";
-    ss << "\"mateIn\":" << info.mateIn() << ",";
-
-    // Best move
-    Move best = ai->getBestMove();
-    ss << "\"bestMove\":[" << best.from() << "," << best.to() << "],";
-
-    // PV lines
-    ss << "\"pvLines\":[";
-    for (size_t i = 0; i < info.pvLines.size(); i++) {
-        if (i > 0) ss << ",";
-        ss << "{\"score\":" << info.pvLines[i].score;
-        ss << ",\"depth\":" << info.pvLines[i].depth;
-        ss << ",\"moves\":[";
-        for (size_t j = 0; j < info.pvLines[i].moves.size(); j++) {
-            if (j > 0) ss << ",";
-            ss << "[" << info.pvLines[i].moves[j].from() << ","
-                 << info.pvLines[i].moves[j].to() << "]";
-        }
-        ss << "]}";
+// Batch analysis. Positions come in as 16-byte records and results go out
+// as 16-byte records, both little endian and shared with types.ts:
+//   position: uint64 pawns, uint8 queen square (64 = none), uint8 side, 6 reserved
+//   result:   uint32 index, int32 score, int16 depth, uint16 best move, uint32 nodes
+// Like the background search, the batch thread queues results and the
+// worker collects them with pollBatch() on a timer.
+struct PackedBatchPosition {
+    uint64_t pawns;
+    uint8_t queenSquare;
+    uint8_t side;
+    uint8_t reserved[6];
+};
+
+struct PackedBatchResult {
+    uint32_t index;
+    int32_t score;
+    int16_t depth;
+    uint16_t bestMove;
+    uint32_t nodes;
+};
+
+static_assert(sizeof(PackedBatchPosition) == 16, "layout is shared with types.ts");
+static_assert(sizeof(PackedBatchResult) == 16, "layout is shared with types.ts");
+
+static std::mutex batchMutex;
+static std::vector<PackedBatchResult> pendingBatch;  // Guarded by batchMutex
+static std::vector<PackedBatchResult> batchResults;  // Behind batchResultsView()
+static bool batchRunning = false;
+
+void bufferBatchResult(const BatchResult& r) {
+    PackedBatchResult packed;
+    packed.index = static_cast<uint32_t>(r.index);
+    packed.score = r.score;
+    packed.depth = static_cast<int16_t>(r.depth);
+    packed.bestMove = r.bestMove.data;
+    packed.nodes = static_cast<uint32_t>(std::min<uint64_t>(r.nodes, UINT32_MAX));
+
+    std::lock_guard<std::mutex> lock(batchMutex);
+    pendingBatch.push_back(packed);
+}
+
+// Start analyzing packed positions in the background, to depth and at
+// most about nodes per position (0 = no limit), spread over the search
+// threads. False if the data is malformed or a search is running.
+bool startBatch(val positions, int depth, int nodes) {
+    if (!ai || ai->isSearching() || depth < 1 || nodes < 0) return false;
+
+    std::vector<uint8_t> data = convertJSArrayToNumberVector<uint8_t>(positions);
+    if (data.size() % sizeof(PackedBatchPosition) != 0) return false;
+
+    std::vector<BatchPosition> batch(data.size() / sizeof(PackedBatchPosition));
+    for (size_t i = 0; i < batch.size(); i++) {
+        PackedBatchPosition packed;
+        std::memcpy(&packed, data.data() + i * sizeof(packed), sizeof(packed));
+        batch[i].pawns = packed.pawns;
+        batch[i].queen = packed.queenSquare < 64 ? squareBB(packed.queenSquare) : 0;
+        batch[i].side = static_cast<Side>(packed.side);  // Out of range is reported invalid
     }
-    ss << "]";
 
-    ss << "}";
-    return ss.str();
+    {
+        std::lock_guard<std::mutex> lock(batchMutex);
+        pendingBatch.clear();
+    }
+    batchRunning = true;
+    ai->setTimeLimit(0);
+    ai->startBatch(std::move(batch), std::min(depth, MAX_PLY - 1),
+                   static_cast<uint64_t>(nodes), bufferBatchResult);
+    return true;
+}
+
+// Move the results finished since the last call behind batchResultsView()
+// and return how many there are. -1 once the batch has finished and every
+// result has been collected.
+int pollBatch() {
+    if (!ai || !batchRunning) return -1;
+
+    bool finished = !ai->isSearching();  // Before draining: no results after it
+    {
+        std::lock_guard<std::mutex> lock(batchMutex);
+        batchResults.swap(pendingBatch);
+        pendingBatch.clear();
+    }
+    if (batchResults.empty() && finished) {
+        batchRunning = false;
+        ai->waitSearch();
+        return -1;
+    }
+    return static_cast<int>(batchResults.size());
 }
 
-// Stop ongoing search
+val batchResultsView() {
+    return val(typed_memory_view(batchResults.size() * sizeof(PackedBatchResult),
+                                 reinterpret_cast<const uint8_t*>(batchResults.data())));
+}
+
+// Stop ongoing search. Returns immediately; a background search then
+// finishes within a few milliseconds and reports through pollSearchResult().
 void stopSearch() {
     if (ai) {
         ai->stopSearch();
@@ -220,14 +446,160 @@ void setSearchCallback(val callback) {
     jsCallback = callback;
 }
 
-// Clear transposition table
+// Clear transposition table (ignored while a search is using it)
 void clearHash() {
-    if (ai) {
+    if (ai && !ai->isSearching()) {
         ai->clearHash();
         ai->clearKillers();
     }
 }
 
+// Number of threads the WASM thread pool can run (the pool is sized to
+// navigator.hardwareConcurrency at startup)
+int getMaxThreads() {
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+// Set number of search threads (Lazy SMP). Clamped to the pool size: the
+// background search and its helpers each take a pool worker, and a thread
+// beyond the pool would wait for a new worker to load.
+void setThreads(int n) {
+    if (ai && !ai->isSearching()) {
+        ai->setThreads(std::min(n, getMaxThreads()));
+    }
+}
+
+// Forward pruning switches per side (see SearchOptions). False while a
+// search is running.
+bool setSearchOptions(bool nullMovePawns, bool nullMoveQueen,
+                      bool lmrPawns, bool lmrQueen, bool verifyNullMove) {
+    if (!ai || ai->isSearching()) return false;
+    SearchOptions opts;
+    opts.nullMove = {nullMovePawns, nullMoveQueen};
+    opts.lmr = {lmrPawns, lmrQueen};
+    opts.verifyNullMove = verifyNullMove;
+    ai->setOptions(opts);
+    return true;
+}
+
+// Profiling counters of the last search or batch as JSON (see SearchStats
+// in ai.h). "enabled" is false, and every counter 0, unless the engine was
+// built with DEFINES=-DSEARCH_STATS. "{}" while a search is running.
+std::string getSearchStats() {
+    if (!ai || ai->isSearching()) return "{}";
+
+    SearchStats s = ai->getSearchStats();
+    std::ostringstream ss;
+    ss << "{\"enabled\":" << (SearchStats::enabled ? "true" : "false");
+    ss << ",\"mainNodes\":" << s.mainNodes << ",\"qsNodes\":" << s.qsNodes;
+    ss << ",\"betaCutoffs\":" << s.betaCutoffs
+       << ",\"firstMoveCutoffRate\":" << s.firstMoveCutoffRate();
+    ss << ",\"cutoffsAt\":[";
+    for (int i = 0; i < SearchStats::CUTOFF_SLOTS; i++) {
+        if (i > 0) ss << ",";
+        ss << s.cutoffsAt[i];
+    }
+    ss << "],\"ttProbes\":" << s.ttProbes << ",\"ttHits\":" << s.ttHits
+       << ",\"ttCollisions\":" << s.ttCollisions << ",\"ttStores\":" << s.ttStores
+       << ",\"ttOverwrites\":" << s.ttOverwrites;
+
+    // Nodes per iteration, up to the last one that ran
+    int lastDepth = MAX_PLY - 1;
+    while (lastDepth > 0 && s.iterationNodes[lastDepth] == 0) lastDepth--;
+    ss << ",\"iterationNodes\":[";
+    for (int d = 1; d <= lastDepth; d++) {
+        if (d > 1) ss << ",";
+        ss << s.iterationNodes[d];
+    }
+    ss << "],\"movegenMs\":" << s.movegenNs / 1e6 << ",\"evalMs\":" << s.evalNs / 1e6
+       << ",\"orderingMs\":" << s.orderingNs / 1e6;
+    ss << "}";
+    return ss.str();
+}
+
+// Resize the transposition table (clears it). Returns the size actually
+// allocated: a power of two, at most MAX_HASH_MB.
+int setHashSize(int mb) {
+    if (!ai || ai->isSearching()) return 0;
+    ai->setHashSizeMB(mb);
+    return ai->getHashSizeMB();
+}
+
+// Load tablebase file contents (Uint8Array, see tablebase.h for the
+// format). Returns the number of pawns covered, or 0 if the data is invalid.
+int loadTablebase(val bytes) {
+    if (ai && ai->isSearching()) return 0;
+
+    std::vector<uint8_t> data = convertJSArrayToNumberVector<uint8_t>(bytes);
+
+    Tablebase* tb = new Tablebase();
+    if (!tb->load(data.data(), data.size())) {
+        delete tb;
+        return 0;
+    }
+
+    if (ai) ai->setTablebase(tb);
+    delete tablebase;
+    tablebase = tb;
+    return tablebase->getMaxPawns();
+}
+
+// Snapshot the transposition table (see tt.h for the format) to persist
+// between sessions. The view is valid until the next saveTT() call, so copy
+// it out. Null while a search is running.
+static std::vector<uint8_t> ttSnapshot;
+
+val saveTT() {
+    if (!ai || ai->isSearching()) return val::null();
+    ttSnapshot = ai->saveTT();
+    return val(typed_memory_view(ttSnapshot.size(), ttSnapshot.data()));
+}
+
+// Merge a saved snapshot into the table. False if the data is invalid, was
+// saved from a smaller table, or a search is running.
+bool loadTT(val bytes) {
+    if (!ai || ai->isSearching()) return false;
+    std::vector<uint8_t> data = convertJSArrayToNumberVector<uint8_t>(bytes);
+    return ai->loadTT(data.data(), data.size());
+}
+
+// Load opening book file contents (Uint8Array, see book.h for the format).
+// Returns the number of positions, or 0 if the data is invalid or a search
+// is running.
+int loadBook(val bytes) {
+    if (ai && ai->isSearching()) return 0;
+
+    std::vector<uint8_t> data = convertJSArrayToNumberVector<uint8_t>(bytes);
+
+    OpeningBook* b = new OpeningBook();
+    if (!b->load(data.data(), data.size())) {
+        delete b;
+        return 0;
+    }
+
+    if (ai) ai->setBook(b);
+    delete book;
+    book = b;
+    return static_cast<int>(book->size());
+}
+
+// Solve tablebases in-engine instead of fetching them (a few pawns only:
+// 3 pawns takes about a second natively)
+int generateTablebase(int maxPawns) {
+    if (ai && ai->isSearching()) return 0;
+
+    Tablebase* tb = new Tablebase();
+    if (!tb->generate(maxPawns)) {
+        delete tb;
+        return 0;
+    }
+
+    if (ai) ai->setTablebase(tb);
+    delete tablebase;
+    tablebase = tb;
+    return tablebase->getMaxPawns();
+}
+
 // Convert square index to algebraic notation
 std::string squareToAlgebraic(int sq) {
     if (sq < 0 || sq >= 64) return "";
@@ -265,9 +637,28 @@ EMSCRIPTEN_BINDINGS(pigs_and_farmers) {
     function("undoMove", &undoMove);
     function("getMoveHistory", &getMoveHistory);
     function("searchBestMove", &searchBestMove);
+    function("startSearch", &startSearch);
+    function("pollSearchInfo", &pollSearchInfo);
+    function("pollSearchResult", &pollSearchResult);
+    function("startPonder", &startPonder);
+    function("ponderHit", &ponderHit);
+    function("searchInfoView", &searchInfoView);
+    function("startBatch", &startBatch);
+    function("pollBatch", &pollBatch);
+    function("batchResultsView", &batchResultsView);
     function("stopSearch", &stopSearch);
     function("setSearchCallback", &setSearchCallback);
     function("clearHash", &clearHash);
+    function("setThreads", &setThreads);
+    function("getMaxThreads", &getMaxThreads);
+    function("setHashSize", &setHashSize);
+    function("setSearchOptions", &setSearchOptions);
+    function("getSearchStats", &getSearchStats);
+    function("loadTablebase", &loadTablebase);
+    function("generateTablebase", &generateTablebase);
+    function("loadBook", &loadBook);
+    function("saveTT", &saveTT);
+    function("loadTT", &loadTT);
     function("squareToAlgebraic", &squareToAlgebraic);
     function("moveToAlgebraic", &moveToAlgebraic);
     function("evaluate", &evaluate);
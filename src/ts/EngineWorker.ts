@@ -2,6 +2,16 @@
 
 declare const self: DedicatedWorkerGlobalScope;
 
+// Forward pruning switches, per side (SearchOptions in ai.h). Pawn-side null
+// moves are off by default: blocked pawns are often in zugzwang.
+interface SearchOptions {
+  nullMovePawns: boolean;
+  nullMoveQueen: boolean;
+  lmrPawns: boolean;
+  lmrQueen: boolean;
+  verifyNullMove: boolean;
+}
+
 interface WasmModule {
   init(): void;
   resetGame(): void;
@@ -10,10 +20,30 @@ interface WasmModule {
   makeMove(from: number, to: number): boolean;
   undoMove(): boolean;
   getMoveHistory(): string;
-  searchBestMove(depth: number, timeMs: number, multiPV: number): string;
+  searchBestMove(depth: number, timeMs: number, multiPV: number): Uint8Array | null;
+  startSearch(depth: number, timeMs: number, multiPV: number): boolean;
+  pollSearchInfo(): boolean;
+  pollSearchResult(): boolean;
+  startPonder(from: number, to: number, depth: number, timeMs: number, multiPV: number): boolean;
+  ponderHit(): boolean;
+  searchInfoView(): Uint8Array;
+  startBatch(positions: Uint8Array, depth: number, nodes: number): boolean;
+  pollBatch(): number;
+  batchResultsView(): Uint8Array;
   stopSearch(): void;
-  setSearchCallback(callback: (info: string) => void): void;
+  setSearchCallback(callback: (info: Uint8Array) => void): void;
   clearHash(): void;
+  setThreads(n: number): void;
+  getMaxThreads(): number;
+  setHashSize(mb: number): number;
+  setSearchOptions(nullMovePawns: boolean, nullMoveQueen: boolean,
+                   lmrPawns: boolean, lmrQueen: boolean, verifyNullMove: boolean): boolean;
+  getSearchStats(): string;
+  loadTablebase(data: Uint8Array): number;
+  generateTablebase(maxPawns: number): number;
+  loadBook(data: Uint8Array): number;
+  saveTT(): Uint8Array | null;
+  loadTT(data: Uint8Array): boolean;
   squareToAlgebraic(sq: number): string;
   moveToAlgebraic(from: number, to: number): string;
   evaluate(): number;
@@ -31,20 +61,146 @@ type WorkerMessage =
   | { type: 'undoMove' }
   | { type: 'getMoveHistory' }
   | { type: 'search'; depth: number; timeMs: number; multiPV: number }
+  | { type: 'ponder'; from: number; to: number; depth: number; timeMs: number; multiPV: number }
+  | { type: 'ponderHit' }
+  | { type: 'analyzeBatch'; positions: Uint8Array; depth: number; nodes: number }
   | { type: 'stopSearch' }
-  | { type: 'clearHash' };
+  | { type: 'clearHash' }
+  | { type: 'setThreads'; threads: number }
+  | { type: 'setHashSize'; mb: number }
+  | { type: 'saveHash' }
+  | { type: 'setSearchOptions'; options: SearchOptions }
+  | { type: 'getSearchStats' };
+
+// Load the WASM module: the SIMD128 build where this module (one SIMD
+// instruction) validates, the scalar build otherwise
+const SIMD_PROBE = new Uint8Array([
+  0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0,
+  10, 10, 1, 8, 0, 65, 0, 253, 15, 253, 98, 11
+]);
+importScripts(WebAssembly.validate(SIMD_PROBE) ? '/pigs_and_farmers_simd.js' : '/pigs_and_farmers.js');
+
+const SEARCH_POLL_MS = 20;
+
+// Search info is a small fixed-layout buffer in WASM memory (decode it with
+// decodeSearchInfo from types.ts). That memory is shared, so it can't be
+// transferred: copy it out and hand the copy over to the main thread.
+function postSearchInfo(type: string, view: Uint8Array): void {
+  const data = view.slice().buffer;
+  self.postMessage({ type, data }, [data]);
+}
+
+// The engine searches on its own thread, so this worker keeps handling
+// messages (stop, new positions) and collects progress and the result on
+// a timer
+function pollSearch(): void {
+  if (wasm!.pollSearchInfo()) {
+    postSearchInfo('searchProgress', wasm!.searchInfoView());
+  }
+  if (wasm!.pollSearchResult()) {
+    postSearchInfo('searchComplete', wasm!.searchInfoView());
+    return;
+  }
+  setTimeout(pollSearch, SEARCH_POLL_MS);
+}
+
+// Batch results stream back the same way, as packed records (decode them
+// with decodeBatchResults from types.ts)
+function pollBatch(count: number): void {
+  const n = wasm!.pollBatch();
+  if (n < 0) {
+    self.postMessage({ type: 'batchComplete', count });
+    return;
+  }
+  if (n > 0) {
+    const data = wasm!.batchResultsView().slice().buffer;
+    self.postMessage({ type: 'batchProgress', data }, [data]);
+  }
+  setTimeout(() => pollBatch(count + n), SEARCH_POLL_MS);
+}
+
+// Endgame tablebases are optional (built with `make tablebase`)
+async function loadTablebase(): Promise<void> {
+  try {
+    const response = await fetch('/tablebase.bin');
+    if (response.ok) {
+      wasm!.loadTablebase(new Uint8Array(await response.arrayBuffer()));
+    }
+  } catch {
+    // Search without tablebases
+  }
+}
+
+// The opening book is optional too (built with `make book`). It downloads in
+// the background: searches before it arrives just search, and it is
+// installed ahead of the first search after that.
+let pendingBook: Uint8Array | null = null;
+
+function fetchBook(): void {
+  fetch('/book.bin')
+    .then((response) => (response.ok ? response.arrayBuffer() : null))
+    .then((buffer) => {
+      if (buffer) pendingBook = new Uint8Array(buffer);
+    })
+    .catch(() => {
+      // Search without a book
+    });
+}
+
+// Transposition table snapshots persist in IndexedDB so repeated analyses
+// of the same lines start warm after a reload
+const SNAPSHOT_DB = 'pigs-and-farmers';
+const SNAPSHOT_STORE = 'tt';
+const SNAPSHOT_KEY = 'snapshot';
+
+function requestResult<T>(request: IDBRequest<T>): Promise<T> {
+  return new Promise((resolve, reject) => {
+    request.onsuccess = () => resolve(request.result);
+    request.onerror = () => reject(request.error);
+  });
+}
+
+function openSnapshotDb(): Promise<IDBDatabase> {
+  const request = indexedDB.open(SNAPSHOT_DB, 1);
+  request.onupgradeneeded = () => request.result.createObjectStore(SNAPSHOT_STORE);
+  return requestResult(request);
+}
+
+async function loadSnapshot(): Promise<void> {
+  try {
+    const db = await openSnapshotDb();
+    const store = db.transaction(SNAPSHOT_STORE, 'readonly').objectStore(SNAPSHOT_STORE);
+    const data = await requestResult(store.get(SNAPSHOT_KEY));
+    if (data instanceof Uint8Array) wasm!.loadTT(data);
+  } catch {
+    // Start with an empty table
+  }
+}
 
-// Load the WASM module
-importScripts('/pigs_and_farmers.js');
+async function saveSnapshot(): Promise<boolean> {
+  const view = wasm!.saveTT();
+  if (!view) return false;
+  try {
+    const db = await openSnapshotDb();
+    const store = db.transaction(SNAPSHOT_STORE, 'readwrite').objectStore(SNAPSHOT_STORE);
+    await requestResult(store.put(view.slice(), SNAPSHOT_KEY));  // Copy out of WASM memory
+    return true;
+  } catch {
+    return false;
+  }
+}
 
 async function initWasm(): Promise<void> {
   // @ts-ignore - PigsAndFarmersModule is loaded via importScripts
   wasm = await PigsAndFarmersModule();
   wasm!.init();
+  await loadTablebase();
+  await loadSnapshot();
+  fetchBook();
 
   // Set up search callback
-  wasm!.setSearchCallback((infoJson: string) => {
-    self.postMessage({ type: 'searchProgress', data: infoJson });
+  wasm!.setSearchCallback((view: Uint8Array) => {
+    postSearchInfo('searchProgress', view);
   });
 
   self.postMessage({ type: 'ready' });
@@ -68,7 +224,6 @@ self.onmessage = async (e: MessageEvent<WorkerMessage>) => {
     switch (msg.type) {
       case 'reset':
         wasm.resetGame();
-        wasm.clearHash();
         self.postMessage({ type: 'reset', success: true });
         break;
 
@@ -98,8 +253,41 @@ self.onmessage = async (e: MessageEvent<WorkerMessage>) => {
         break;
 
       case 'search':
-        const result = wasm.searchBestMove(msg.depth, msg.timeMs, msg.multiPV);
-        self.postMessage({ type: 'searchComplete', data: result });
+        if (pendingBook) {
+          wasm.loadBook(pendingBook);
+          pendingBook = null;
+        }
+        if (wasm.startSearch(msg.depth, msg.timeMs, msg.multiPV)) {
+          pollSearch();
+        } else {
+          self.postMessage({ type: 'searchComplete', data: null });
+        }
+        break;
+
+      // Search the position after the expected reply on the opponent's
+      // time. Completes like 'search', but only after ponderHit (or a stop)
+      case 'ponder':
+        if (pendingBook) {
+          wasm.loadBook(pendingBook);
+          pendingBook = null;
+        }
+        if (wasm.startPonder(msg.from, msg.to, msg.depth, msg.timeMs, msg.multiPV)) {
+          pollSearch();
+        } else {
+          self.postMessage({ type: 'searchComplete', data: null });
+        }
+        break;
+
+      case 'ponderHit':
+        self.postMessage({ type: 'ponderHitResult', success: wasm.ponderHit() });
+        break;
+
+      case 'analyzeBatch':
+        if (wasm.startBatch(msg.positions, msg.depth, msg.nodes)) {
+          pollBatch(0);
+        } else {
+          self.postMessage({ type: 'batchComplete', count: 0 });
+        }
         break;
 
       case 'stopSearch':
@@ -111,6 +299,31 @@ self.onmessage = async (e: MessageEvent<WorkerMessage>) => {
         wasm.clearHash();
         self.postMessage({ type: 'hashCleared' });
         break;
+
+      case 'setThreads':
+        wasm.setThreads(msg.threads);
+        self.postMessage({ type: 'threadsSet', maxThreads: wasm.getMaxThreads() });
+        break;
+
+      case 'setHashSize':
+        const hashMB = wasm.setHashSize(msg.mb);
+        self.postMessage({ type: 'hashSizeSet', mb: hashMB });
+        break;
+
+      case 'saveHash':
+        self.postMessage({ type: 'hashSaved', success: await saveSnapshot() });
+        break;
+
+      case 'setSearchOptions':
+        const o = msg.options;
+        const applied = wasm.setSearchOptions(o.nullMovePawns, o.nullMoveQueen,
+                                              o.lmrPawns, o.lmrQueen, o.verifyNullMove);
+        self.postMessage({ type: 'searchOptionsSet', applied });
+        break;
+
+      case 'getSearchStats':
+        self.postMessage({ type: 'searchStats', data: JSON.parse(wasm.getSearchStats()) });
+        break;
     }
   } catch (error) {
     self.postMessage({ type: 'error', error: String(error) });
@@ -4,6 +4,7 @@ import {
   Move,
   SearchInfo,
   WasmModule,
+  decodeSearchInfo,
   squareToAlgebraic,
   moveToAlgebraic as moveToAlg
 } from './types';
@@ -29,29 +30,18 @@ export class GameController {
     this.wasm = await window.PigsAndFarmersModule();
     this.wasm.init();
 
-    // Set up search callback wrapper
-    this.wasm.setSearchCallback((infoJson: string) => {
+    // Set up search callback wrapper. The view points into WASM memory and
+    // is overwritten by the next update, so decode it right away.
+    this.wasm.setSearchCallback((view: Uint8Array) => {
       if (this.searchCallback) {
-        try {
-          const info = JSON.parse(infoJson) as SearchInfo;
-
-          // Convert move arrays [from, to] to Move objects {from, to}
-          if (info.pvLines) {
-            info.pvLines = info.pvLines.map(pv => ({
-              ...pv,
-              moves: (pv.moves as any).map((m: number[]) => ({ from: m[0], to: m[1] }))
-            }));
-          }
+        const info = decodeSearchInfo(view);
 
-          // Use setTimeout to yield to browser and keep UI responsive
-          setTimeout(() => {
-            if (this.searchCallback) {
-              this.searchCallback(info);
-            }
-          }, 0);
-        } catch (e) {
-          console.error('Failed to parse search info:', e);
-        }
+        // Use setTimeout to yield to browser and keep UI responsive
+        setTimeout(() => {
+          if (this.searchCallback) {
+            this.searchCallback(info);
+          }
+        }, 0);
       }
     });
   }
@@ -151,7 +141,6 @@ export class GameController {
     if (!this.wasm) return;
 
     this.wasm.resetGame();
-    this.wasm.clearHash();
     this.moveHistory = [];
     this.currentMoveIndex = -1;
     this.notifyStateChange();
@@ -186,20 +175,8 @@ export class GameController {
 
     return new Promise((resolve) => {
       try {
-        const resultJson = this.wasm!.searchBestMove(depth, timeMs, multiPV);
-        const result = JSON.parse(resultJson) as SearchInfo;
-
-        // Convert bestMove array to Move object
-        if ((result as any).bestMove) {
-          const [from, to] = (result as any).bestMove as number[];
-          result.bestMove = { from, to };
-        }
-
-        // Convert PV line moves
-        result.pvLines = result.pvLines.map(pv => ({
-          ...pv,
-          moves: (pv.moves as any).map((m: number[]) => ({ from: m[0], to: m[1] }))
-        }));
+        const view = this.wasm!.searchBestMove(depth, timeMs, multiPV);
+        const result = view ? decodeSearchInfo(view) : null;
 
         this.isSearching = false;
         resolve(result);
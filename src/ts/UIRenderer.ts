@@ -295,7 +295,7 @@ export class UIRenderer {
   async analyze(): Promise<void> {
     // Toggle analysis
     if (this.isAnalyzing) {
-      // Stop analysis - this will terminate and reinitialize the worker
+      // Stop analysis
       this.setStatus('Stopping analysis...');
       await this.controller.stopSearch();
       this.isAnalyzing = false;
@@ -403,6 +403,7 @@ export class UIRenderer {
   togglePlayComputer(): void {
     this.isPlayingComputer = !this.isPlayingComputer;
     this.updatePlayComputerButton();
+    if (!this.isPlayingComputer) this.controller.stopPonder();
 
     if (this.isPlayingComputer) {
       const state = this.controller.getBoardStateSync();
@@ -433,9 +434,15 @@ export class UIRenderer {
     const result = await this.controller.search(15, 3000, 1);
 
     if (result && result.bestMove && this.isPlayingComputer) {
-      this.controller.makeMove(result.bestMove.from, result.bestMove.to);
+      await this.controller.makeMove(result.bestMove.from, result.bestMove.to);
       this.lastMove = result.bestMove;
       this.bestMoveArrow = null;
+
+      // Ponder on the reply the engine expects while the player thinks
+      const reply = result.pvLines[0]?.moves[1];
+      if (reply && !this.controller.isGameOver()) {
+        this.controller.ponder(reply, 15, 3000, 1);
+      }
     }
 
     this.setStatus('');
@@ -1,18 +1,27 @@
 import {
+  BatchPosition,
+  BatchResult,
   BoardState,
   GameResult,
   Move,
   SearchInfo,
-  PVLine,
-  squareToAlgebraic
+  SearchOptions,
+  SearchStats,
+  decodeBatchResults,
+  decodeSearchInfo,
+  encodeBatchPositions,
+  squareToAlgebraic,
+  wasmBuildName
 } from './types';
 
 export type SearchCallback = (info: SearchInfo) => void;
 export type StateChangeCallback = (state: BoardState) => void;
+export type BatchCallback = (results: BatchResult[]) => void;
 
 export class WorkerGameController {
   private worker: Worker | null = null;
   private searchCallback: SearchCallback | null = null;
+  private batchCallback: BatchCallback | null = null;
   private stateChangeCallback: StateChangeCallback | null = null;
   private isSearching = false;
   private moveHistory: string[] = [];
@@ -22,38 +31,165 @@ export class WorkerGameController {
   // Pending promises for async operations
   private pendingResolvers: Map<string, (value: any) => void> = new Map();
   private messageId = 0;
-  private searchResolver: ((value: any) => void) | null = null;
-  private reinitializing = false;
+  private searchDone: Promise<SearchInfo | null> = Promise.resolve(null);
+  private stopRequested = false;
+
+  // Ponder search in flight: the reply it expects, and once that reply is
+  // played, the result the next search() hands out
+  private ponderMove: Move | null = null;
+  private ponderResult: Promise<SearchInfo | null> | null = null;
 
   async initialize(): Promise<void> {
     return new Promise((resolve, reject) => {
       try {
         // Get the absolute URLs for the WASM module
         const baseUrl = window.location.origin;
-        const wasmJsUrl = new URL('/pigs_and_farmers.js', baseUrl).href;
-        const wasmBinaryUrl = new URL('/pigs_and_farmers.wasm', baseUrl).href;
+        const build = wasmBuildName();
+        const wasmJsUrl = new URL(`/${build}.js`, baseUrl).href;
+        const wasmBinaryUrl = new URL(`/${build}.wasm`, baseUrl).href;
+        const wasmWorkerUrl = new URL(`/${build}.worker.js`, baseUrl).href;
+        const tablebaseUrl = new URL('/tablebase.bin', baseUrl).href;
+        const bookUrl = new URL('/book.bin', baseUrl).href;
 
         // Create worker from inline script to avoid separate file issues
         const workerCode = `
           let wasm = null;
           const wasmJsUrl = '${wasmJsUrl}';
           const wasmBinaryUrl = '${wasmBinaryUrl}';
+          const wasmWorkerUrl = '${wasmWorkerUrl}';
+          const tablebaseUrl = '${tablebaseUrl}';
+          const bookUrl = '${bookUrl}';
 
           importScripts(wasmJsUrl);
 
+          const SEARCH_POLL_MS = 20;
+
+          // Search info is a small fixed-layout buffer in WASM memory. That
+          // memory is shared, so it can't be transferred: copy it out and
+          // hand the copy over to the main thread.
+          function postSearchInfo(type, id, view) {
+            const data = view.slice().buffer;
+            self.postMessage({ type, id, data }, [data]);
+          }
+
+          // The engine searches on its own thread, so this worker keeps
+          // handling messages (stop, new positions) and collects progress
+          // and the result on a timer
+          function pollSearch(id) {
+            if (wasm.pollSearchInfo()) {
+              postSearchInfo('searchProgress', undefined, wasm.searchInfoView());
+            }
+            if (wasm.pollSearchResult()) {
+              postSearchInfo('searchComplete', id, wasm.searchInfoView());
+              return;
+            }
+            setTimeout(() => pollSearch(id), SEARCH_POLL_MS);
+          }
+
+          // Batch results stream back the same way, as packed records
+          function pollBatch(id, count) {
+            const n = wasm.pollBatch();
+            if (n < 0) {
+              self.postMessage({ type: 'batchComplete', id, count });
+              return;
+            }
+            if (n > 0) {
+              const data = wasm.batchResultsView().slice().buffer;
+              self.postMessage({ type: 'batchProgress', data }, [data]);
+            }
+            setTimeout(() => pollBatch(id, count + n), SEARCH_POLL_MS);
+          }
+
+          // The opening book is optional too (built with make book). It
+          // downloads in the background: searches before it arrives just
+          // search, and it is installed ahead of the first search after that.
+          let pendingBook = null;
+
+          function fetchBook() {
+            fetch(bookUrl)
+              .then((response) => response.ok ? response.arrayBuffer() : null)
+              .then((buffer) => {
+                if (buffer) pendingBook = new Uint8Array(buffer);
+              })
+              .catch(() => {
+                // Search without a book
+              });
+          }
+
+          // Transposition table snapshots persist in IndexedDB so repeated
+          // analyses of the same lines start warm after a reload
+          const SNAPSHOT_DB = 'pigs-and-farmers';
+          const SNAPSHOT_STORE = 'tt';
+          const SNAPSHOT_KEY = 'snapshot';
+
+          function requestResult(request) {
+            return new Promise((resolve, reject) => {
+              request.onsuccess = () => resolve(request.result);
+              request.onerror = () => reject(request.error);
+            });
+          }
+
+          function openSnapshotDb() {
+            const request = indexedDB.open(SNAPSHOT_DB, 1);
+            request.onupgradeneeded = () => request.result.createObjectStore(SNAPSHOT_STORE);
+            return requestResult(request);
+          }
+
+          async function loadSnapshot() {
+            try {
+              const db = await openSnapshotDb();
+              const store = db.transaction(SNAPSHOT_STORE, 'readonly').objectStore(SNAPSHOT_STORE);
+              const data = await requestResult(store.get(SNAPSHOT_KEY));
+              if (data instanceof Uint8Array) wasm.loadTT(data);
+            } catch (err) {
+              // Start with an empty table
+            }
+          }
+
+          async function saveSnapshot() {
+            const view = wasm.saveTT();
+            if (!view) return false;
+            try {
+              const db = await openSnapshotDb();
+              const store = db.transaction(SNAPSHOT_STORE, 'readwrite').objectStore(SNAPSHOT_STORE);
+              await requestResult(store.put(view.slice(), SNAPSHOT_KEY));  // Copy out of WASM memory
+              return true;
+            } catch (err) {
+              return false;
+            }
+          }
+
           async function initWasm() {
-            // Configure module to find the WASM binary
+            // Configure module to find the WASM binary. Search threads are
+            // spawned from the main script, which a blob worker can't locate.
             wasm = await PigsAndFarmersModule({
+              mainScriptUrlOrBlob: wasmJsUrl,
               locateFile: (path) => {
                 if (path.endsWith('.wasm')) {
                   return wasmBinaryUrl;
                 }
+                if (path.endsWith('.worker.js')) {
+                  return wasmWorkerUrl;
+                }
                 return path;
               }
             });
             wasm.init();
-            wasm.setSearchCallback((infoJson) => {
-              self.postMessage({ type: 'searchProgress', data: infoJson });
+
+            // Endgame tablebases are optional (built with make tablebase)
+            try {
+              const tbResponse = await fetch(tablebaseUrl);
+              if (tbResponse.ok) {
+                wasm.loadTablebase(new Uint8Array(await tbResponse.arrayBuffer()));
+              }
+            } catch (err) {
+              // Search without tablebases
+            }
+            await loadSnapshot();
+            fetchBook();
+
+            wasm.setSearchCallback((view) => {
+              postSearchInfo('searchProgress', undefined, view);
             });
             self.postMessage({ type: 'ready' });
           }
@@ -79,7 +215,6 @@ export class WorkerGameController {
               switch (msg.type) {
                 case 'reset':
                   wasm.resetGame();
-                  wasm.clearHash();
                   self.postMessage({ type: 'reset', id: msg.id, success: true });
                   break;
 
@@ -106,8 +241,42 @@ export class WorkerGameController {
                   break;
 
                 case 'search':
-                  const result = wasm.searchBestMove(msg.depth, msg.timeMs, msg.multiPV);
-                  self.postMessage({ type: 'searchComplete', id: msg.id, data: result });
+                  if (pendingBook) {
+                    wasm.loadBook(pendingBook);
+                    pendingBook = null;
+                  }
+                  if (wasm.startSearch(msg.depth, msg.timeMs, msg.multiPV)) {
+                    pollSearch(msg.id);
+                  } else {
+                    self.postMessage({ type: 'searchComplete', id: msg.id, data: null });
+                  }
+                  break;
+
+                // Search the position after the expected reply on the
+                // opponent's time. Completes like 'search', but only after
+                // ponderHit (or a stop)
+                case 'ponder':
+                  if (pendingBook) {
+                    wasm.loadBook(pendingBook);
+                    pendingBook = null;
+                  }
+                  if (wasm.startPonder(msg.from, msg.to, msg.depth, msg.timeMs, msg.multiPV)) {
+                    pollSearch(msg.id);
+                  } else {
+                    self.postMessage({ type: 'searchComplete', id: msg.id, data: null });
+                  }
+                  break;
+
+                case 'ponderHit':
+                  self.postMessage({ type: 'ponderHitResult', id: msg.id, success: wasm.ponderHit() });
+                  break;
+
+                case 'analyzeBatch':
+                  if (wasm.startBatch(msg.positions, msg.depth, msg.nodes)) {
+                    pollBatch(msg.id, 0);
+                  } else {
+                    self.postMessage({ type: 'batchComplete', id: msg.id, count: 0 });
+                  }
                   break;
 
                 case 'stopSearch':
@@ -120,6 +289,32 @@ export class WorkerGameController {
                   self.postMessage({ type: 'hashCleared', id: msg.id });
                   break;
 
+                case 'setThreads':
+                  wasm.setThreads(msg.threads);
+                  self.postMessage({ type: 'threadsSet', id: msg.id, maxThreads: wasm.getMaxThreads() });
+                  break;
+
+                case 'setHashSize':
+                  const hashMB = wasm.setHashSize(msg.mb);
+                  self.postMessage({ type: 'hashSizeSet', id: msg.id, mb: hashMB });
+                  break;
+
+                case 'saveHash':
+                  self.postMessage({ type: 'hashSaved', id: msg.id, success: await saveSnapshot() });
+                  break;
+
+                case 'setSearchOptions':
+                  const o = msg.options;
+                  const applied = wasm.setSearchOptions(o.nullMovePawns, o.nullMoveQueen,
+                                                        o.lmrPawns, o.lmrQueen, o.verifyNullMove);
+                  self.postMessage({ type: 'searchOptionsSet', id: msg.id, applied });
+                  break;
+
+                case 'getSearchStats':
+                  self.postMessage({ type: 'searchStats', id: msg.id,
+                                     data: JSON.parse(wasm.getSearchStats()) });
+                  break;
+
                 case 'moveToAlgebraic':
                   const algebraic = wasm.moveToAlgebraic(msg.from, msg.to);
                   self.postMessage({ type: 'algebraic', id: msg.id, data: algebraic });
@@ -154,6 +349,11 @@ export class WorkerGameController {
             return;
           }
 
+          if (msg.type === 'batchProgress') {
+            this.batchCallback?.(decodeBatchResults(msg.data));
+            return;
+          }
+
           if (msg.type === 'error') {
             console.error('Worker error:', msg.error);
             const resolver = this.pendingResolvers.get(msg.id);
@@ -195,24 +395,10 @@ export class WorkerGameController {
     });
   }
 
-  private handleSearchProgress(infoJson: string): void {
-    if (!this.searchCallback) return;
-
-    try {
-      const info = JSON.parse(infoJson) as SearchInfo;
-
-      // Convert move arrays to Move objects
-      if (info.pvLines) {
-        info.pvLines = info.pvLines.map(pv => ({
-          ...pv,
-          moves: (pv.moves as any).map((m: number[]) => ({ from: m[0], to: m[1] }))
-        }));
-      }
-
-      this.searchCallback(info);
-    } catch (e) {
-      console.error('Failed to parse search progress:', e);
-    }
+  private handleSearchProgress(data: ArrayBuffer): void {
+    // Ponder lines belong to a position that isn't on the board yet
+    if (!this.searchCallback || this.ponderMove) return;
+    this.searchCallback(decodeSearchInfo(data));
   }
 
   setSearchCallback(callback: SearchCallback): void {
@@ -269,8 +455,21 @@ export class WorkerGameController {
   }
 
   async makeMove(from: number, to: number): Promise<boolean> {
+    const ponder = this.ponderMove;
+    if (ponder && ponder.from === from && ponder.to === to) {
+      // Ponder hit: the running search becomes the reply to this move
+      this.ponderMove = null;
+      this.ponderResult = this.searchDone;
+      await this.sendMessage({ type: 'ponderHit' });
+      return this.applyMove(from, to);
+    }
+
+    await this.stopPonder();
     if (this.isSearching) return false;
+    return this.applyMove(from, to);
+  }
 
+  private async applyMove(from: number, to: number): Promise<boolean> {
     const response = await this.sendMessage({ type: 'makeMove', from, to });
     if (response?.success) {
       // Update cached state
@@ -278,9 +477,6 @@ export class WorkerGameController {
         this.cachedBoardState = JSON.parse(response.state);
       }
 
-      // Clear hash table after move to ensure fresh analysis
-      await this.sendMessage({ type: 'clearHash' });
-
       // Truncate future moves if not at the end
       if (this.currentMoveIndex < this.moveHistory.length - 1) {
         this.moveHistory = this.moveHistory.slice(0, this.currentMoveIndex + 1);
@@ -298,6 +494,7 @@ export class WorkerGameController {
   }
 
   async undoMove(): Promise<boolean> {
+    await this.stopPonder();
     if (this.isSearching) return false;
     if (this.currentMoveIndex < 0) return false;
 
@@ -314,6 +511,7 @@ export class WorkerGameController {
   }
 
   async redoMove(): Promise<boolean> {
+    await this.stopPonder();
     if (this.isSearching) return false;
     if (this.currentMoveIndex >= this.moveHistory.length - 1) return false;
 
@@ -336,6 +534,7 @@ export class WorkerGameController {
   }
 
   async resetGame(): Promise<void> {
+    await this.stopPonder();
     await this.sendMessage({ type: 'reset' });
     this.moveHistory = [];
     this.currentMoveIndex = -1;
@@ -344,6 +543,7 @@ export class WorkerGameController {
   }
 
   async goToMove(index: number): Promise<void> {
+    await this.stopPonder();
     if (this.isSearching) return;
 
     // Reset to start
@@ -367,95 +567,173 @@ export class WorkerGameController {
   }
 
   async search(depth: number = 20, timeMs: number = 5000, multiPV: number = 3): Promise<SearchInfo | null> {
-    if (this.isSearching || this.reinitializing) return null;
+    // After a ponder hit the search for this position is already running
+    const pondered = this.ponderResult;
+    this.ponderResult = null;
+    if (pondered) {
+      const info = await pondered;
+      if (info) return info;
+    }
+
+    await this.stopPonder();
+    if (this.isSearching) return null;
 
     this.isSearching = true;
+    this.stopRequested = false;
+
+    this.searchDone = this.sendMessage({
+      type: 'search',
+      depth,
+      timeMs,
+      multiPV
+    }).then((response) => {
+      this.isSearching = false;
+
+      // A stopped search resolves with null, like before
+      if (this.stopRequested || !response?.data) {
+        return null;
+      }
 
-    return new Promise((resolve) => {
-      this.searchResolver = resolve;
-
-      this.sendMessage({
-        type: 'search',
-        depth,
-        timeMs,
-        multiPV
-      }).then((response) => {
-        this.searchResolver = null;
-        this.isSearching = false;
-
-        if (response?.data) {
-          try {
-            const result = JSON.parse(response.data) as SearchInfo;
-
-            // Convert bestMove array to Move object
-            if ((result as any).bestMove) {
-              const [from, to] = (result as any).bestMove as number[];
-              result.bestMove = { from, to };
-            }
+      return decodeSearchInfo(response.data as ArrayBuffer);
+    }).catch((e) => {
+      console.error('Search failed:', e);
+      this.isSearching = false;
+      return null;
+    });
 
-            // Convert PV line moves
-            if (result.pvLines) {
-              result.pvLines = result.pvLines.map(pv => ({
-                ...pv,
-                moves: (pv.moves as any).map((m: number[]) => ({ from: m[0], to: m[1] }))
-              }));
-            }
+    return this.searchDone;
+  }
 
-            resolve(result);
-          } catch (e) {
-            console.error('Search parse failed:', e);
-            resolve(null);
-          }
-        } else {
-          resolve(null);
-        }
-      }).catch((e) => {
-        console.error('Search failed:', e);
-        this.searchResolver = null;
-        this.isSearching = false;
-        resolve(null);
-      });
+  // Search the position after the expected reply while the opponent
+  // thinks. If makeMove() then plays that reply, the next search() takes
+  // over this search, with the time already spent counting towards
+  // timeMs. Any other move, undo or reset stops it first; the engine's
+  // TT keeps what it found. False if the engine is busy.
+  ponder(reply: Move, depth: number = 20, timeMs: number = 5000, multiPV: number = 3): boolean {
+    if (this.isSearching) return false;
+
+    this.isSearching = true;
+    this.stopRequested = false;
+    this.ponderMove = reply;
+
+    this.searchDone = this.sendMessage({
+      type: 'ponder',
+      from: reply.from,
+      to: reply.to,
+      depth,
+      timeMs,
+      multiPV
+    }).then((response) => {
+      this.isSearching = false;
+      this.ponderMove = null;
+
+      if (this.stopRequested || !response?.data) {
+        return null;
+      }
+
+      return decodeSearchInfo(response.data as ArrayBuffer);
+    }).catch((e) => {
+      console.error('Ponder failed:', e);
+      this.isSearching = false;
+      this.ponderMove = null;
+      return null;
     });
+
+    return true;
+  }
+
+  isPondering(): boolean {
+    return this.ponderMove !== null;
+  }
+
+  // Drop a ponder search whose expected reply didn't come
+  async stopPonder(): Promise<void> {
+    if (!this.ponderMove) return;
+
+    this.ponderMove = null;
+    await this.stopSearch();
+  }
+
+  // Analyze many positions in one job, to depth and at most about nodes
+  // per position (0 = no limit), spread over the engine's threads with one
+  // shared TT. Results reach onResults in batches as they finish, not in
+  // input order. Resolves with the number of results; stopSearch()
+  // cancels the rest.
+  async analyzeBatch(positions: BatchPosition[], depth: number, nodes: number,
+                     onResults: BatchCallback): Promise<number> {
+    if (this.isSearching) return 0;
+
+    this.isSearching = true;
+    this.batchCallback = onResults;
+
+    const done = this.sendMessage({
+      type: 'analyzeBatch',
+      positions: encodeBatchPositions(positions),
+      depth,
+      nodes
+    }).then((response) => {
+      this.isSearching = false;
+      this.batchCallback = null;
+      return (response?.count as number) ?? 0;
+    });
+    this.searchDone = done.then(() => null);
+    return done;
   }
 
   async stopSearch(): Promise<void> {
     if (!this.isSearching) return;
 
-    // The worker is blocked in a synchronous search call and can't receive messages.
-    // We need to terminate the worker and reinitialize it.
-    this.reinitializing = true;
-    this.isSearching = false;
+    // The worker stays responsive while the engine searches on its own
+    // thread, so the stop flag is seen within milliseconds. Wait for the
+    // search to wind down so a following move or search isn't rejected.
+    this.stopRequested = true;
+    await this.sendMessage({ type: 'stopSearch' });
+    await this.searchDone;
+  }
 
-    // Resolve the pending search promise with null
-    if (this.searchResolver) {
-      this.searchResolver(null);
-      this.searchResolver = null;
-    }
+  // Set the number of Lazy SMP search threads. Returns the pool size the
+  // engine clamps to.
+  async setThreads(threads: number): Promise<number> {
+    if (this.isSearching) return 0;
+
+    const response = await this.sendMessage({ type: 'setThreads', threads });
+    return response?.maxThreads ?? 1;
+  }
 
-    // Clear all pending resolvers
-    this.pendingResolvers.forEach((resolver) => resolver(null));
-    this.pendingResolvers.clear();
+  // Resize the engine's transposition table (clears it). Returns the size
+  // in MB actually allocated.
+  async setHashSize(mb: number): Promise<number> {
+    if (this.isSearching) return 0;
 
-    // Terminate the worker
-    this.worker?.terminate();
-    this.worker = null;
+    const response = await this.sendMessage({ type: 'setHashSize', mb });
+    return response?.mb ?? 0;
+  }
 
-    // Reinitialize the worker
-    await this.initialize();
+  // Persist the transposition table to IndexedDB, reloaded when the worker
+  // next starts. False if the engine was busy or storage failed.
+  async saveHash(): Promise<boolean> {
+    if (this.isSearching) return false;
 
-    // Replay moves to get back to current position
-    for (const moveStr of this.moveHistory.slice(0, this.currentMoveIndex + 1)) {
-      const from = (moveStr.charCodeAt(0) - 'a'.charCodeAt(0)) +
-                   (moveStr.charCodeAt(1) - '1'.charCodeAt(0)) * 8;
-      const to = (moveStr.charCodeAt(2) - 'a'.charCodeAt(0)) +
-                 (moveStr.charCodeAt(3) - '1'.charCodeAt(0)) * 8;
-      await this.sendMessage({ type: 'makeMove', from, to });
-    }
+    const response = await this.sendMessage({ type: 'saveHash' });
+    return response?.success ?? false;
+  }
 
-    // Refresh cached state
-    await this.getBoardState();
+  // Switch null-move pruning and late move reductions per side. Returns
+  // false if the engine was busy.
+  async setSearchOptions(options: SearchOptions): Promise<boolean> {
+    if (this.isSearching) return false;
+
+    const response = await this.sendMessage({ type: 'setSearchOptions', options });
+    return response?.applied ?? false;
+  }
+
+  // Profiling counters of the last search or batch, null while searching.
+  // Counted only by engines built with DEFINES=-DSEARCH_STATS.
+  async getSearchStats(): Promise<SearchStats | null> {
+    if (this.isSearching) return null;
 
-    this.reinitializing = false;
+    const response = await this.sendMessage({ type: 'getSearchStats' });
+    return response?.data ?? null;
   }
 
   getMoveHistory(): string[] {
@@ -24,6 +24,11 @@ async function main() {
     const initialState = await controller.getBoardState();
     renderer.render(initialState);
 
+    // Keep the engine's transposition table for the next visit
+    document.addEventListener('visibilitychange', () => {
+      if (document.visibilityState === 'hidden') controller.saveHash();
+    });
+
     // Hide loading, show app
     if (loadingEl) loadingEl.style.display = 'none';
     if (appEl) appEl.style.display = 'flex';
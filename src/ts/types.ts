@@ -40,6 +40,36 @@ export interface SearchInfo {
   bestMove?: Move;
 }
 
+// Forward pruning switches, per side (SearchOptions in ai.h). Pawn-side null
+// moves are off by default: blocked pawns are often in zugzwang.
+export interface SearchOptions {
+  nullMovePawns: boolean;
+  nullMoveQueen: boolean;
+  lmrPawns: boolean;
+  lmrQueen: boolean;
+  verifyNullMove: boolean;
+}
+
+// Search profiling counters (SearchStats in ai.h). All zero unless the
+// engine is built with DEFINES=-DSEARCH_STATS, see `enabled`.
+export interface SearchStats {
+  enabled: boolean;
+  mainNodes: number;
+  qsNodes: number;
+  betaCutoffs: number;
+  firstMoveCutoffRate: number;
+  cutoffsAt: number[];       // Cutoffs by move number, the last entry is move 8+
+  ttProbes: number;
+  ttHits: number;
+  ttCollisions: number;
+  ttStores: number;
+  ttOverwrites: number;
+  iterationNodes: number[];  // Nodes of each iteration, depth 1 first
+  movegenMs: number;
+  evalMs: number;
+  orderingMs: number;
+}
+
 export interface WasmModule {
   init(): void;
   resetGame(): void;
@@ -48,15 +78,150 @@ export interface WasmModule {
   makeMove(from: number, to: number): boolean;
   undoMove(): boolean;
   getMoveHistory(): string;
-  searchBestMove(depth: number, timeMs: number, multiPV: number): string;
+  searchBestMove(depth: number, timeMs: number, multiPV: number): Uint8Array | null;
+  startSearch(depth: number, timeMs: number, multiPV: number): boolean;
+  pollSearchInfo(): boolean;
+  pollSearchResult(): boolean;
+  startPonder(from: number, to: number, depth: number, timeMs: number, multiPV: number): boolean;
+  ponderHit(): boolean;
+  searchInfoView(): Uint8Array;
+  startBatch(positions: Uint8Array, depth: number, nodes: number): boolean;
+  pollBatch(): number;
+  batchResultsView(): Uint8Array;
   stopSearch(): void;
-  setSearchCallback(callback: (info: string) => void): void;
+  setSearchCallback(callback: (info: Uint8Array) => void): void;
   clearHash(): void;
+  setThreads(n: number): void;
+  getMaxThreads(): number;
+  setHashSize(mb: number): number;
+  setSearchOptions(nullMovePawns: boolean, nullMoveQueen: boolean,
+                   lmrPawns: boolean, lmrQueen: boolean, verifyNullMove: boolean): boolean;
+  getSearchStats(): string;
+  loadTablebase(data: Uint8Array): number;
+  generateTablebase(maxPawns: number): number;
+  loadBook(data: Uint8Array): number;
+  saveTT(): Uint8Array | null;
+  loadTT(data: Uint8Array): boolean;
   squareToAlgebraic(sq: number): string;
   moveToAlgebraic(from: number, to: number): string;
   evaluate(): number;
 }
 
+// Binary search info, packed by SearchInfoBuffer in wasm_bindings.cpp (keep
+// the offsets in sync). Little-endian; moves are the engine's 16-bit
+// encoding, from | to << 6 | flags << 12.
+const SEARCH_INFO_MATE = 1;
+const SEARCH_INFO_BEST_MOVE = 2;
+const SEARCH_INFO_LINES_OFFSET = 44;
+const SEARCH_INFO_LINE_SIZE = 136;
+
+function decodeMove(data: number): Move {
+  return { from: data & 0x3f, to: (data >> 6) & 0x3f };
+}
+
+export function decodeSearchInfo(bytes: ArrayBuffer | Uint8Array): SearchInfo {
+  const view = bytes instanceof Uint8Array
+    ? new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength)
+    : new DataView(bytes);
+
+  const flags = view.getUint16(36, true);
+  const lineCount = view.getUint16(40, true);
+  const pvLines: PVLine[] = [];
+  for (let i = 0; i < lineCount; i++) {
+    const base = SEARCH_INFO_LINES_OFFSET + i * SEARCH_INFO_LINE_SIZE;
+    const length = view.getUint16(base + 6, true);
+    const moves: Move[] = [];
+    for (let j = 0; j < length; j++) {
+      moves.push(decodeMove(view.getUint16(base + 8 + j * 2, true)));
+    }
+    pvLines.push({
+      score: view.getInt32(base, true),
+      depth: view.getInt16(base + 4, true),
+      moves
+    });
+  }
+
+  const info: SearchInfo = {
+    depth: view.getInt32(0, true),
+    selDepth: view.getInt32(4, true),
+    score: view.getInt32(8, true),
+    mateIn: view.getInt32(12, true),
+    nodes: Number(view.getBigUint64(16, true)),
+    nps: Number(view.getBigUint64(24, true)),
+    timeMs: view.getInt32(32, true),
+    isMate: (flags & SEARCH_INFO_MATE) !== 0,
+    pvLines
+  };
+  if (flags & SEARCH_INFO_BEST_MOVE) {
+    info.bestMove = decodeMove(view.getUint16(38, true));
+  }
+  return info;
+}
+
+// Batch analysis records, packed by wasm_bindings.cpp (keep in sync)
+export interface BatchPosition {
+  pawns: number[];          // Square indices
+  queen: number;            // Square index, -1 if captured
+  sideToMove: number;       // 0 = White (Pigs), 1 = Black (Farmer)
+}
+
+export interface BatchResult {
+  index: number;            // Into the positions passed in
+  score: number;            // From White's perspective
+  depth: number;            // 0 if the game is over, -1 if the position is invalid
+  bestMove?: Move;
+  nodes: number;
+}
+
+const BATCH_RECORD_SIZE = 16;
+
+export function encodeBatchPositions(positions: BatchPosition[]): Uint8Array {
+  const bytes = new Uint8Array(positions.length * BATCH_RECORD_SIZE);
+  const view = new DataView(bytes.buffer);
+  positions.forEach((p, i) => {
+    const base = i * BATCH_RECORD_SIZE;
+    let pawns = 0n;
+    for (const sq of p.pawns) pawns |= 1n << BigInt(sq);
+    view.setBigUint64(base, pawns, true);
+    view.setUint8(base + 8, p.queen >= 0 ? p.queen : 64);
+    view.setUint8(base + 9, p.sideToMove);
+  });
+  return bytes;
+}
+
+export function decodeBatchResults(bytes: ArrayBuffer | Uint8Array): BatchResult[] {
+  const view = bytes instanceof Uint8Array
+    ? new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength)
+    : new DataView(bytes);
+
+  const results: BatchResult[] = [];
+  for (let base = 0; base + BATCH_RECORD_SIZE <= view.byteLength; base += BATCH_RECORD_SIZE) {
+    const result: BatchResult = {
+      index: view.getUint32(base, true),
+      score: view.getInt32(base + 4, true),
+      depth: view.getInt16(base + 8, true),
+      nodes: view.getUint32(base + 12, true)
+    };
+    const move = view.getUint16(base + 10, true);
+    if (move !== 0) result.bestMove = decodeMove(move);
+    results.push(result);
+  }
+  return results;
+}
+
+// Smallest module using a SIMD128 instruction: one function returning
+// i8x16.splat(0) reduced to an i32
+const SIMD_PROBE = new Uint8Array([
+  0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0,
+  10, 10, 1, 8, 0, 65, 0, 253, 15, 253, 98, 11
+]);
+
+// Base name of the engine build to load: the SIMD one (`make wasm-simd`)
+// where the browser supports it, the scalar one otherwise
+export function wasmBuildName(): string {
+  return WebAssembly.validate(SIMD_PROBE) ? 'pigs_and_farmers_simd' : 'pigs_and_farmers';
+}
+
 // Square utilities
 export const FILES = ['a', 'b', 'c', 'd', 'e', 'f', 'g', 'h'];
 export const RANKS = ['1', '2', '3', '4', '5', '6', '7', '8'];
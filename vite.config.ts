@@ -27,6 +27,6 @@ export default defineConfig({
     }
   },
   optimizeDeps: {
-    exclude: ['pigs_and_farmers.js']
+    exclude: ['pigs_and_farmers.js', 'pigs_and_farmers_simd.js']
   }
 });